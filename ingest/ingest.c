@@ -0,0 +1,573 @@
+/*
+ * Vegimeter 2 fleet telemetry ingester
+ *
+ * Reads the telemetry frames of many units and appends the readings of
+ * every FRAME_STATUS to one time series per unit and channel (see
+ * series.h). The units send their frames in XBee API packets (see
+ * src/xbee_api.h). A coordinator stream carries the packets of many units,
+ * each one is known by the source address of its packets and gets a
+ * directory named after it the first time it is heard. A unit stream
+ * carries the packets of one unit, as a capture of the simulator does.
+ *
+ * All the streams are served by one thread from poll(); the frames are
+ * decoded in place in a fixed buffer per unit, nothing is allocated per
+ * packet.
+ *
+ *   vegimeter_ingest [-d dir] [-c coordinator] ... [unit=path] ...
+ *       ingest until every stream ended or SIGINT/SIGTERM
+ *   vegimeter_ingest [-d dir] -q unit channel [from [to]] [-l]
+ *       summary of the points with from <= t < to (milliseconds since the
+ *       epoch), -l also lists them
+ *   vegimeter_ingest [-d dir] -b units [hours]
+ *       ingest synthetic reports of that many units on one coordinator,
+ *       as fast as possible
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "frame.h"
+#include "series.h"
+#include "xbee_api.h"
+
+/* The temperatures by role, then the heater duty. */
+#define CHANNEL_HEATER_DUTY NUM_SENSORS
+#define NUM_CHANNELS (NUM_SENSORS + 1)
+/* Longest frame, and room for the next packet. */
+#define UNIT_BUFFER_SIZE (2 * FRAME_SIZE(255))
+/* Units heard on the coordinators, the hash table is twice as big. Must be
+ * a power of two. */
+#define MAX_UNITS 4096
+#define UNIT_HASH_SIZE (2 * MAX_UNITS)
+#define STREAM_READ_SIZE 4096
+
+static const char* sensor_names[NUM_SENSORS] = SENSOR_NAMES;
+
+struct unit {
+  char name[32];
+  struct xbee_addr addr;
+  uint8_t buf[UNIT_BUFFER_SIZE];
+  size_t len;
+  uint64_t packets;
+  uint64_t frames;
+  uint64_t crc_errors;
+  uint64_t skipped; /* Bytes */
+  struct series series[NUM_CHANNELS];
+};
+
+struct stream {
+  const char* path;
+  int fd;
+  struct unit* unit; /* NULL for a coordinator */
+  struct xbee_api_parser api;
+};
+
+static const char* store = ".";
+static struct unit* unit_hash[UNIT_HASH_SIZE];
+static int num_units = 0;
+static struct unit* units[MAX_UNITS];
+
+static uint16_t crc16_table[256];
+static volatile sig_atomic_t stopping = 0;
+
+/* CRC-16/CCITT a byte at a time, as crc16_update() in src/frame.c. */
+static void crc16_init() {
+  uint16_t crc;
+  int i, j;
+
+  for (i = 0; i < 256; i++) {
+    crc = i << 8;
+    for (j = 0; j < 8; j++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    crc16_table[i] = crc;
+  }
+}
+
+static uint16_t crc16(const uint8_t* data, size_t n) {
+  uint16_t crc = 0xFFFF;
+
+  while (n--) {
+    crc = (crc << 8) ^ crc16_table[(crc >> 8) ^ *data++];
+  }
+  return crc;
+}
+
+static int64_t now_ms() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static const char* channel_name(int channel) {
+  return channel == CHANNEL_HEATER_DUTY ? "heater_duty" :
+    sensor_names[channel];
+}
+
+/* Creates the unit and maps its series. */
+static struct unit* unit_new(const char* name) {
+  char path[PATH_MAX];
+  struct unit* u;
+  int i;
+
+  if (num_units == MAX_UNITS) {
+    fprintf(stderr, "%s: more than %d units\n", name, MAX_UNITS);
+    return NULL;
+  }
+  u = calloc(1, sizeof(*u));
+  if (u == NULL) {
+    perror("calloc");
+    return NULL;
+  }
+  snprintf(u->name, sizeof(u->name), "%s", name);
+  snprintf(path, sizeof(path), "%s/%s", store, u->name);
+  if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+    perror(path);
+    free(u);
+    return NULL;
+  }
+  for (i = 0; i < NUM_CHANNELS; i++) {
+    snprintf(path, sizeof(path), "%s/%s/%s", store, u->name,
+             channel_name(i));
+    if (series_open(&u->series[i], path) < 0) {
+      perror(path);
+      while (i--) {
+        series_close(&u->series[i]);
+      }
+      free(u);
+      return NULL;
+    }
+  }
+  units[num_units++] = u;
+  return u;
+}
+
+static void unit_close(struct unit* u) {
+  int i;
+
+  for (i = 0; i < NUM_CHANNELS; i++) {
+    series_close(&u->series[i]);
+  }
+}
+
+static uint32_t addr_hash(const struct xbee_addr* a) {
+  uint32_t h = 2166136261U; /* FNV-1a */
+  int i;
+
+  for (i = 0; i < a->size; i++) {
+    h = (h ^ a->bytes[i]) * 16777619U;
+  }
+  return h;
+}
+
+/* The unit of a coordinator packet, created the first time it is heard.
+ * Units are named after their address in hex. */
+static struct unit* unit_at(const struct xbee_addr* a) {
+  uint32_t i = addr_hash(a) & (UNIT_HASH_SIZE - 1);
+  struct unit* u;
+  char name[2 * sizeof(a->bytes) + 1];
+  int j;
+
+  for (; (u = unit_hash[i]) != NULL; i = (i + 1) & (UNIT_HASH_SIZE - 1)) {
+    if (u->addr.size == a->size &&
+        !memcmp(u->addr.bytes, a->bytes, a->size)) {
+      return u;
+    }
+  }
+  for (j = 0; j < a->size; j++) {
+    sprintf(name + 2 * j, "%02X", a->bytes[j]);
+  }
+  u = unit_new(name);
+  if (u != NULL) {
+    u->addr = *a;
+    unit_hash[i] = u;
+  }
+  return u;
+}
+
+static int16_t get_i16(const uint8_t* p) {
+  return (int16_t)(p[0] | p[1] << 8);
+}
+
+static void unit_status(struct unit* u, const uint8_t* payload,
+                        uint8_t length, int64_t t) {
+  int16_t temp;
+  int i;
+
+  if (length < FRAME_STATUS_SIZE) {
+    return;
+  }
+  for (i = 0; i < NUM_SENSORS; i++) {
+    temp = get_i16(payload + 2 * i);
+    if (temp != FRAME_NO_READING) {
+      series_append(&u->series[i], t, temp);
+    }
+  }
+  series_append(&u->series[CHANNEL_HEATER_DUTY], t,
+                (uint16_t)get_i16(payload + 2 * NUM_SENSORS + 2));
+}
+
+/* Decodes the whole frames in the buffer and keeps the rest. */
+static void unit_feed(struct unit* u, int64_t t) {
+  uint8_t* buf = u->buf;
+  uint8_t* sync;
+  size_t i = 0, end;
+  uint8_t length;
+
+  while (i < u->len) {
+    sync = memchr(buf + i, FRAME_SYNC0, u->len - i);
+    if (sync == NULL) {
+      u->skipped += u->len - i;
+      i = u->len;
+      break;
+    }
+    u->skipped += sync - (buf + i);
+    i = sync - buf;
+    if (i + FRAME_HEADER_SIZE > u->len) {
+      break;
+    }
+    if (buf[i + 1] != FRAME_SYNC1) {
+      u->skipped++;
+      i++;
+      continue;
+    }
+    length = buf[i + 4];
+    end = i + FRAME_SIZE(length);
+    if (end > u->len) {
+      break;
+    }
+    if (buf[i + 2] != FRAME_VERSION ||
+        crc16(buf + i + 2, FRAME_HEADER_SIZE - 2 + length) !=
+        (buf[end - 2] | buf[end - 1] << 8)) {
+      u->crc_errors++;
+      u->skipped++;
+      i++;
+      continue;
+    }
+    u->frames++;
+    if (buf[i + 3] == FRAME_STATUS) {
+      unit_status(u, buf + i + FRAME_HEADER_SIZE, length, t);
+    }
+    i = end;
+  }
+  /* Keep the start of the next frame. */
+  memmove(buf, buf + i, u->len - i);
+  u->len -= i;
+}
+
+/* A frame of the stream is complete. Frames split over packets are put
+ * back together in the buffer of their unit. */
+static void stream_frame(struct stream* s, uint16_t length, int64_t t) {
+  struct xbee_packet packet;
+  struct unit* u;
+
+  if (xbee_api_packet(s->api.frame, length, &packet) < 0) {
+    return; /* TX status, AT command responses */
+  }
+  u = s->unit ? s->unit : unit_at(&packet.addr);
+  if (u == NULL) {
+    return;
+  }
+  u->packets++;
+  memcpy(u->buf + u->len, packet.data, packet.size);
+  u->len += packet.size;
+  unit_feed(u, t);
+}
+
+static void stream_feed(struct stream* s, const uint8_t* data, size_t n,
+                        int64_t t) {
+  uint16_t length;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    length = xbee_api_parse(&s->api, data[i]);
+    if (length > 0) {
+      stream_frame(s, length, t);
+    }
+  }
+}
+
+static int stream_open(struct stream* s, const char* path,
+                       struct unit* unit) {
+  struct termios tio;
+
+  s->path = path;
+  s->unit = unit;
+  xbee_api_parser_init(&s->api);
+  s->fd = open(path, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+  if (s->fd < 0) {
+    perror(path);
+    return -1;
+  }
+  if (isatty(s->fd) && tcgetattr(s->fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B9600);
+    cfsetospeed(&tio, B9600);
+    tcsetattr(s->fd, TCSANOW, &tio);
+  }
+  return 0;
+}
+
+static void on_signal(int sig) {
+  stopping = 1;
+}
+
+static int ingest(struct stream* streams, int num_streams) {
+  struct pollfd* fds = calloc(num_streams, sizeof(*fds));
+  uint8_t data[STREAM_READ_SIZE];
+  int i, open_streams = num_streams;
+  ssize_t n;
+  int64_t t;
+
+  if (fds == NULL) {
+    return 1;
+  }
+  for (i = 0; i < num_streams; i++) {
+    fds[i].fd = streams[i].fd;
+    fds[i].events = POLLIN;
+  }
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  while (open_streams > 0 && !stopping) {
+    if (poll(fds, num_streams, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("poll");
+      break;
+    }
+    t = now_ms();
+    for (i = 0; i < num_streams; i++) {
+      if (!fds[i].revents) {
+        continue;
+      }
+      n = read(fds[i].fd, data, sizeof(data));
+      if (n > 0) {
+        stream_feed(&streams[i], data, n, t);
+      } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+        /* End of file, or the other end of the PTY went away. */
+        close(fds[i].fd);
+        fds[i].fd = -1;
+        open_streams--;
+      }
+    }
+  }
+  free(fds);
+  return 0;
+}
+
+/* Encodes a frame as the firmware would, for the load benchmark. */
+static size_t encode_frame(uint8_t* out, uint8_t type, uint16_t seq,
+                           const uint8_t* payload, uint8_t length) {
+  uint16_t crc;
+
+  out[0] = FRAME_SYNC0;
+  out[1] = FRAME_SYNC1;
+  out[2] = FRAME_VERSION;
+  out[3] = type;
+  out[4] = length;
+  out[5] = seq & 0xFF;
+  out[6] = seq >> 8;
+  memcpy(out + FRAME_HEADER_SIZE, payload, length);
+  crc = crc16(out + 2, FRAME_HEADER_SIZE - 2 + length);
+  out[FRAME_HEADER_SIZE + length] = crc & 0xFF;
+  out[FRAME_HEADER_SIZE + length + 1] = crc >> 8;
+  return FRAME_SIZE(length);
+}
+
+/*
+ * Feeds a coordinator stream a report a minute from every unit for that
+ * many hours: a FRAME_STATUS and the FRAME_IDLE that follows it in one
+ * packet, as the XBee cog of the unit packs them.
+ */
+static int bench(int units_heard, int hours) {
+  uint8_t status[FRAME_STATUS_SIZE], idle[FRAME_IDLE_SIZE];
+  uint8_t data[XBEE_API_MAX_PAYLOAD];
+  uint8_t packet[XBEE_API_MAX_ENCODED];
+  struct stream coordinator;
+  struct xbee_addr src;
+  int64_t t0 = now_ms(), t;
+  struct timespec start, end;
+  double seconds;
+  uint64_t packets = 0, bytes = 0;
+  int minute, i, j;
+  int16_t temp;
+  size_t n;
+
+  memset(&coordinator, 0, sizeof(coordinator));
+  xbee_api_parser_init(&coordinator.api);
+  memset(idle, 0, sizeof(idle));
+  memset(status, 0, sizeof(status));
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (minute = 0; minute < hours * 60; minute++) {
+    t = t0 + (int64_t)minute * 60000;
+    for (i = 0; i < units_heard; i++) {
+      for (j = 0; j < NUM_SENSORS; j++) {
+        temp = 1800 + (minute + i + 37 * j) % 600;
+        status[2 * j] = temp & 0xFF;
+        status[2 * j + 1] = temp >> 8;
+      }
+      n = encode_frame(data, FRAME_STATUS, 2 * minute, status,
+                       sizeof(status));
+      n += encode_frame(data + n, FRAME_IDLE, 2 * minute + 1, idle,
+                        sizeof(idle));
+      xbee_addr16(&src, i + 1);
+      n = xbee_api_rx(packet, &src, 40, 0, data, n);
+      stream_feed(&coordinator, packet, n, t);
+      packets++;
+      bytes += n;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%d units, %d hours: %llu packets, %llu bytes in %.3f s, "
+         "%.0f packets/s, %.2f us per report\n", units_heard, hours,
+         (unsigned long long)packets, (unsigned long long)bytes, seconds,
+         packets / seconds, 1e6 * seconds / packets);
+  return 0;
+}
+
+static void print_point(int64_t t, int32_t v, void* arg) {
+  printf("%lld %d\n", (long long)t, v);
+}
+
+static int query(const char* unit, const char* channel, int64_t from,
+                 int64_t to, int list) {
+  char path[PATH_MAX];
+  struct series s;
+  struct series_summary sum;
+
+  snprintf(path, sizeof(path), "%s/%s/%s", store, unit, channel);
+  if (access(path, R_OK) < 0 || series_open(&s, path) < 0) {
+    perror(path);
+    return 1;
+  }
+  if (list) {
+    series_points(&s, from, to, print_point, NULL);
+  }
+  series_summary(&s, from, to, &sum);
+  if (sum.n == 0) {
+    printf("no points\n");
+  } else {
+    printf("%llu points from %lld to %lld: min %d max %d mean %.2f\n",
+           (unsigned long long)sum.n, (long long)sum.first,
+           (long long)sum.last, sum.min, sum.max, (double)sum.sum / sum.n);
+  }
+  series_close(&s);
+  return 0;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: vegimeter_ingest [-d dir] [-c coordinator] ... "
+          "[unit=path] ...\n"
+          "       vegimeter_ingest [-d dir] -q unit channel [from [to]] "
+          "[-l]\n"
+          "       vegimeter_ingest [-d dir] -b units [hours]\n");
+}
+
+int main(int argc, char* argv[]) {
+  struct stream* streams;
+  struct unit* u;
+  int num_streams = 0, hours = 24, list = 0, ret = 0, i;
+  int64_t from = 0, to = INT64_MAX;
+  char* eq;
+
+  crc16_init();
+  i = 1;
+  if (i + 1 < argc && !strcmp(argv[i], "-d")) {
+    store = argv[i + 1];
+    i += 2;
+  }
+  if (i < argc && !strcmp(argv[i], "-q")) {
+    if (argc - i < 3) {
+      usage();
+      return 2;
+    }
+    if (!strcmp(argv[argc - 1], "-l")) {
+      list = 1;
+      argc--;
+    }
+    if (argc - i > 3) {
+      from = strtoll(argv[i + 3], NULL, 0);
+    }
+    if (argc - i > 4) {
+      to = strtoll(argv[i + 4], NULL, 0);
+    }
+    return query(argv[i + 1], argv[i + 2], from, to, list);
+  }
+  if (i < argc && !strcmp(argv[i], "-b")) {
+    if (argc - i < 2 || atoi(argv[i + 1]) <= 0 ||
+        atoi(argv[i + 1]) > MAX_UNITS) {
+      usage();
+      return 2;
+    }
+    if (argc - i > 2) {
+      hours = atoi(argv[i + 2]);
+    }
+    ret = bench(atoi(argv[i + 1]), hours);
+  } else {
+    if (i >= argc) {
+      usage();
+      return 2;
+    }
+    streams = calloc(argc - i, sizeof(*streams));
+    if (streams == NULL) {
+      perror("calloc");
+      return 1;
+    }
+    for (; i < argc; i++, num_streams++) {
+      if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+        u = NULL;
+        i++;
+      } else {
+        eq = strchr(argv[i], '=');
+        if (eq == NULL || eq == argv[i] ||
+            eq - argv[i] >= (int)sizeof(u->name)) {
+          usage();
+          return 2;
+        }
+        *eq = '\0';
+        u = unit_new(argv[i]);
+        argv[i] = eq + 1;
+        if (u == NULL) {
+          return 1;
+        }
+      }
+      if (stream_open(&streams[num_streams], argv[i], u) < 0) {
+        return 1;
+      }
+    }
+    ret = ingest(streams, num_streams);
+    free(streams);
+  }
+
+  for (i = 0; i < num_units; i++) {
+    u = units[i];
+    if (u->packets > 0 && num_units <= 64) {
+      fprintf(stderr, "%s: %llu packets, %llu frames, %llu CRC errors, "
+              "%llu bytes skipped\n", u->name,
+              (unsigned long long)u->packets, (unsigned long long)u->frames,
+              (unsigned long long)u->crc_errors,
+              (unsigned long long)u->skipped);
+    }
+    unit_close(u);
+    free(u);
+  }
+  if (num_units > 64) {
+    fprintf(stderr, "%d units\n", num_units);
+  }
+  return ret;
+}
@@ -0,0 +1,227 @@
+/*
+ * Vegimeter 2 time series store
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "series.h"
+
+static size_t series_size(uint32_t blocks) {
+  return sizeof(struct series_header) +
+    (size_t)blocks * sizeof(struct series_block);
+}
+
+static void series_map(struct series* s, void* map, size_t size) {
+  s->header = map;
+  s->blocks = (struct series_block*)(s->header + 1);
+  s->size = size;
+}
+
+int series_open(struct series* s, const char* path) {
+  struct series_header header;
+  struct stat st;
+  void* map;
+  int fd;
+
+  if (strlen(path) >= sizeof(s->path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(s->path, path);
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+  if (fstat(fd, &st) < 0) {
+    goto fail;
+  }
+  if (st.st_size == 0) {
+    memset(&header, 0, sizeof(header));
+    header.magic = SERIES_MAGIC;
+    header.block_points = SERIES_BLOCK_POINTS;
+    header.capacity = SERIES_GROW_BLOCKS;
+    if (ftruncate(fd, series_size(header.capacity)) < 0 ||
+        pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+      goto fail;
+    }
+    st.st_size = series_size(header.capacity);
+  } else if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+             header.magic != SERIES_MAGIC ||
+             header.block_points != SERIES_BLOCK_POINTS ||
+             header.num_blocks > header.capacity ||
+             (off_t)series_size(header.capacity) > st.st_size) {
+    errno = EINVAL;
+    goto fail;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    goto fail;
+  }
+  close(fd);
+  series_map(s, map, st.st_size);
+  /* The file may have grown just before a crash. */
+  s->header->capacity = (st.st_size - sizeof(struct series_header)) /
+    sizeof(struct series_block);
+  return 0;
+
+ fail:
+  close(fd);
+  return -1;
+}
+
+/* Makes room for SERIES_GROW_BLOCKS more blocks. */
+static int series_grow(struct series* s) {
+  uint32_t capacity = s->header->capacity + SERIES_GROW_BLOCKS;
+  size_t size = series_size(capacity);
+  void* map;
+  int fd;
+
+  fd = open(s->path, O_RDWR);
+  if (fd < 0) {
+    return -1;
+  }
+  if (ftruncate(fd, size) < 0) {
+    close(fd);
+    return -1;
+  }
+  close(fd);
+  map = mremap(s->header, s->size, size, MREMAP_MAYMOVE);
+  if (map == MAP_FAILED) {
+    return -1;
+  }
+  series_map(s, map, size);
+  s->header->capacity = capacity;
+  return 0;
+}
+
+int series_append(struct series* s, int64_t t, int32_t v) {
+  struct series_header* h = s->header;
+  struct series_block* b = h->num_blocks ? &s->blocks[h->num_blocks - 1] :
+    NULL;
+
+  if (b && t < b->last) {
+    t = b->last;
+  }
+  if (!b || b->n == SERIES_BLOCK_POINTS) {
+    if (h->num_blocks == h->capacity) {
+      if (series_grow(s) < 0) {
+        return -1;
+      }
+      h = s->header;
+    }
+    b = &s->blocks[h->num_blocks];
+    memset(b, 0, offsetof(struct series_block, t));
+    b->first = t;
+    b->min = b->max = v;
+    h->num_blocks++;
+  }
+  b->t[b->n] = t;
+  b->v[b->n] = v;
+  b->last = t;
+  b->sum += v;
+  if (v < b->min) {
+    b->min = v;
+  }
+  if (v > b->max) {
+    b->max = v;
+  }
+  __sync_synchronize();
+  b->n++;
+  return 0;
+}
+
+/* First block that ends at or after t. */
+static uint32_t series_find(const struct series* s, int64_t t) {
+  uint32_t lo = 0, hi = s->header->num_blocks, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (s->blocks[mid].last < t) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static void summary_add(struct series_summary* sum, int64_t first,
+                        int64_t last, uint64_t n, int64_t total, int32_t min,
+                        int32_t max) {
+  if (sum->n == 0) {
+    sum->first = first;
+    sum->min = min;
+    sum->max = max;
+  }
+  sum->last = last;
+  sum->n += n;
+  sum->sum += total;
+  if (min < sum->min) {
+    sum->min = min;
+  }
+  if (max > sum->max) {
+    sum->max = max;
+  }
+}
+
+void series_summary(const struct series* s, int64_t from, int64_t to,
+                    struct series_summary* sum) {
+  const struct series_block* b;
+  uint32_t i, j;
+
+  memset(sum, 0, sizeof(*sum));
+  for (i = series_find(s, from); i < s->header->num_blocks; i++) {
+    b = &s->blocks[i];
+    if (b->n == 0 || b->first >= to) {
+      break;
+    }
+    if (b->first >= from && b->last < to) {
+      /* Covered whole, the summary will do. */
+      summary_add(sum, b->first, b->last, b->n, b->sum, b->min, b->max);
+      continue;
+    }
+    for (j = 0; j < b->n; j++) {
+      if (b->t[j] >= from && b->t[j] < to) {
+        summary_add(sum, b->t[j], b->t[j], 1, b->v[j], b->v[j], b->v[j]);
+      }
+    }
+  }
+}
+
+void series_points(const struct series* s, int64_t from, int64_t to,
+                   void (*fn)(int64_t t, int32_t v, void* arg), void* arg) {
+  const struct series_block* b;
+  uint32_t i, j;
+
+  for (i = series_find(s, from); i < s->header->num_blocks; i++) {
+    b = &s->blocks[i];
+    for (j = 0; j < b->n; j++) {
+      if (b->t[j] >= to) {
+        return;
+      }
+      if (b->t[j] >= from) {
+        fn(b->t[j], b->v[j], arg);
+      }
+    }
+  }
+}
+
+int series_sync(struct series* s) {
+  return msync(s->header, s->size, MS_ASYNC);
+}
+
+void series_close(struct series* s) {
+  if (s->header) {
+    msync(s->header, s->size, MS_SYNC);
+    munmap(s->header, s->size);
+    s->header = NULL;
+    s->blocks = NULL;
+  }
+}
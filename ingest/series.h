@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_SERIES_H
+#define __VEGIMETER2_SERIES_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Memory-mapped columnar time series, one file per unit and channel.
+ *
+ * The file is a header followed by fixed size blocks of points in time
+ * order. Each block keeps its timestamps and its values in two columns and
+ * starts with a summary: the time span, the count, min, max and sum of its
+ * values. A range query binary searches the blocks on their time span,
+ * takes the summary of every block that the range covers whole and only
+ * reads the points of the two blocks at its ends.
+ *
+ * The file grows SERIES_GROW_BLOCKS at a time. Points are written straight
+ * into the mapping; the count in the block summary is updated last, so a
+ * crash loses at most the point being appended.
+ */
+#define SERIES_MAGIC 0x31534756 /* "VGS1" */
+#define SERIES_BLOCK_POINTS 1024
+#define SERIES_GROW_BLOCKS 16
+
+struct series_header {
+  uint32_t magic;
+  uint32_t block_points; /* SERIES_BLOCK_POINTS */
+  uint32_t num_blocks; /* In use, only the last one may be partial */
+  uint32_t capacity; /* Blocks the file has room for */
+  uint32_t reserved[12];
+};
+
+struct series_block {
+  int64_t first; /* Milliseconds since the epoch */
+  int64_t last;
+  int64_t sum;
+  int32_t min;
+  int32_t max;
+  uint32_t n;
+  uint32_t reserved[7];
+  int64_t t[SERIES_BLOCK_POINTS];
+  int32_t v[SERIES_BLOCK_POINTS];
+};
+
+struct series {
+  char path[PATH_MAX];
+  struct series_header* header;
+  struct series_block* blocks;
+  size_t size; /* Of the mapping, bytes */
+};
+
+struct series_summary {
+  uint64_t n;
+  int64_t first; /* Time of the first point in the range */
+  int64_t last;
+  int64_t sum;
+  int32_t min;
+  int32_t max;
+};
+
+/* Maps the series at path, creating it if needed. Returns 0 or -1 with
+ * errno set. The file is not kept open. */
+int series_open(struct series* s, const char* path);
+/* Appends a point. Time does not go back: t is raised to the last time of
+ * the series if it is older. Returns 0 or -1 with errno set. */
+int series_append(struct series* s, int64_t t, int32_t v);
+/* Summarizes the points with from <= t < to. */
+void series_summary(const struct series* s, int64_t from, int64_t to,
+                    struct series_summary* sum);
+/* Calls fn for each point with from <= t < to, in time order. */
+void series_points(const struct series* s, int64_t from, int64_t to,
+                   void (*fn)(int64_t t, int32_t v, void* arg), void* arg);
+/* Flushes the mapping to the file. */
+int series_sync(struct series* s);
+void series_close(struct series* s);
+
+#endif /* __VEGIMETER2_SERIES_H */
@@ -0,0 +1,305 @@
+/*
+ * Vegimeter 2 control energy benchmark
+ *
+ * Runs the engine against the thermal plant over multi-day scenarios, much
+ * faster than real time, and reports the heater and pump energy, the time
+ * the soil spent in the band and the relay switch counts.
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "hal.h"
+#include "buttons.h"
+#include "engine.h"
+#include "frame.h"
+#include "history.h"
+#include "idle.h"
+#include "sched.h"
+#include "sensors.h"
+#include "telemetry.h"
+#include "xbee_api.h"
+#include "xbee_rx.h"
+#include "xbee_tx.h"
+#include "sim.h"
+
+static const struct scenario scenarios[] = {
+  /* name, days, mean, swing, snap day, snap drop, soil, water, read
+   * errors, seed */
+  { "mild", 3, 14.0, 4.0, 0, 0, 18.0, 18.0, 0, 1 },
+  { "cold", 3, 6.0, 5.0, 0, 0, 12.0, 12.0, 0, 2 },
+  { "cold-snap", 4, 14.0, 4.0, 2.0, 10.0, 21.0, 21.0, 0, 3 },
+  { "noisy-bus", 3, 14.0, 4.0, 0, 0, 18.0, 18.0, 0.01, 4 },
+  { "frost", 5, 4.0, 10.0, 2.45, 15.0, 21.0, 21.0, 0, 5 },
+};
+#define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+/*
+ * Simulated cogs, each one polls its scheduler whenever its next deadline
+ * comes. The engine cog runs the control and the actuators tasks.
+ */
+struct cog {
+  const char* name;
+  struct sched* sched;
+  const char* tasks[4];
+  uint64_t next; /* Cycles */
+};
+
+static struct cog cogs[] = {
+  { "sensors", &sensors_sched, { "convert", "read" }, 0 },
+  { "engine", &engine_sched, { "control", "actuators" }, 0 },
+  { "telemetry", &telemetry_sched, { "report", "leds", "host", "buttons" },
+    0 },
+};
+#define NUM_COGS (sizeof(cogs) / sizeof(cogs[0]))
+
+struct result {
+  double heater_wh;
+  double wh_per_kh; /* Heater energy per degree-hour of air below 21 C */
+  double run_min; /* Mean heater run */
+  double pump_wh;
+  double in_band; /* % */
+  double below; /* C * h */
+  double above; /* C * h */
+  unsigned int heater_runs;
+  unsigned int pump_switches;
+  unsigned long telemetry_bytes; /* On the serial line to the XBee */
+  unsigned long packets;
+  unsigned long frame_bytes; /* In the packets */
+  int halt;
+  double halt_day;
+  double wall; /* Seconds */
+};
+
+/* Everything the XBee would have sent goes there, if set. */
+static FILE* capture = NULL;
+
+/* Sends a command frame to the device, as the host would through the
+ * coordinator. */
+static void send_command(uint8_t type) {
+  static uint16_t seq = 0;
+  uint8_t frame[FRAME_SIZE(0)];
+  uint8_t packet[XBEE_API_MAX_ENCODED];
+  struct xbee_addr coordinator;
+  uint16_t crc = 0xFFFF;
+  uint16_t size;
+  int i;
+
+  frame[0] = FRAME_SYNC0;
+  frame[1] = FRAME_SYNC1;
+  frame[2] = FRAME_VERSION;
+  frame[3] = type;
+  frame[4] = 0;
+  frame[5] = seq & 0xFF;
+  frame[6] = seq++ >> 8;
+  for (i = 2; i < FRAME_HEADER_SIZE; i++) {
+    crc = crc16_update(crc, frame[i]);
+  }
+  frame[FRAME_HEADER_SIZE] = crc & 0xFF;
+  frame[FRAME_HEADER_SIZE + 1] = crc >> 8;
+  xbee_addr16(&coordinator, XBEE_COORDINATOR16);
+  size = xbee_api_rx(packet, &coordinator, 40, 0, frame, sizeof(frame));
+  for (i = 0; i < size; i++) {
+    xbee_rx_put(packet[i]);
+  }
+}
+
+/* Everything in the transmit buffer goes out right away, in as few
+ * packets as the XBee cog would use. No TX status is asked for. */
+static void send_packets(struct result* r) {
+  uint8_t data[XBEE_API_MAX_PAYLOAD];
+  uint8_t packet[XBEE_API_MAX_ENCODED];
+  struct xbee_addr coordinator;
+  uint16_t size;
+  uint8_t n;
+
+  xbee_addr16(&coordinator, XBEE_COORDINATOR16);
+  while ((n = xbee_tx_gather(data, sizeof(data))) > 0) {
+    size = xbee_api_tx(packet, 0, &coordinator, 0, data, n);
+    r->packets++;
+    r->frame_bytes += n;
+    r->telemetry_bytes += size;
+    if (capture) {
+      fwrite(packet, 1, size, capture);
+    }
+  }
+}
+
+/* Polls the cog that is due next, which then naps in idle_until() as in
+ * sched_run(), on its own idle account. */
+static void step(struct result* r) {
+  struct cog* c = &cogs[0];
+  unsigned int i;
+  uint32_t wait;
+
+  for (i = 1; i < NUM_COGS; i++) {
+    if (cogs[i].next < c->next) {
+      c = &cogs[i];
+    }
+  }
+  sim_advance_to(c->next);
+  wait = sched_poll(c->sched);
+  sim_wake = sim_time + wait;
+  sim_nap = 1;
+  idle_until(c->sched->cog, CNT + wait);
+  sim_nap = 0;
+  hal_cnt = (uint32_t)sim_time;
+  c->next = sim_wake;
+  send_packets(r);
+  if (!r->halt && control_mailbox.data.halt) {
+    r->halt = control_mailbox.data.halt;
+    r->halt_day = sim_seconds() / 86400.0;
+  }
+}
+
+static void run(const struct scenario* s, struct result* r) {
+  uint64_t end = (uint64_t)(s->days * 86400.0) * SIM_CLKFREQ;
+  unsigned int i;
+  clock_t wall = clock();
+
+  memset(r, 0, sizeof(*r));
+  sim_reset();
+  plant_init(s);
+  ds18b20_sim_reset();
+  ds18b20_sim_read_errors = s->read_errors;
+  eeprom_sim_reset();
+  /* The simulated DS18B20 are wired as in the sensor table, the probes of
+   * the plant are in role order. */
+  for (i = 0; i < NUM_PROBES; i++) {
+    ds18b20_sim_add(sensor_config[i].pin, i);
+  }
+  xbee_tx.head = xbee_tx.tail = 0;
+  xbee_rx.head = xbee_rx.tail = 0;
+  buttons.head = buttons.tail = 0;
+
+  engine_init();
+  sensors_init();
+  telemetry_init();
+  for (i = 0; i < NUM_COGS; i++) {
+    cogs[i].next = 0;
+  }
+
+  while (sim_time < end) {
+    step(r);
+  }
+  if (capture) {
+    /* A tap on the first pad, as the buttons cog would queue it. */
+    button_ring_put(&buttons, 0, BUTTON_PRESS, CNT);
+    button_ring_put(&buttons, 0, BUTTON_RELEASE, CNT + SIM_CLKFREQ / 10);
+    /* Get the history log out at the end, as after an outage. */
+    send_command(FRAME_CMD_HISTORY_DUMP);
+    while (xbee_rx.tail != xbee_rx.head || history_dumping()) {
+      step(r);
+    }
+  }
+  sim_sync();
+
+  r->heater_wh = plant.heater_energy / 3600.0;
+  r->wh_per_kh = plant.demand > 0 ? r->heater_wh / (plant.demand / 3600.0) : 0;
+  r->run_min = plant.heater_runs ?
+    plant.heater_on / 60.0 / plant.heater_runs : 0;
+  r->pump_wh = plant.pump_energy / 3600.0;
+  r->in_band = 100.0 * plant.in_band / plant.t;
+  r->below = plant.below_band / 3600.0;
+  r->above = plant.above_band / 3600.0;
+  r->heater_runs = plant.heater_runs;
+  r->pump_switches = plant.pump_switches;
+  r->wall = (double)(clock() - wall) / CLOCKS_PER_SEC;
+}
+
+/* Runs, overruns and the worst start lateness of every task, and the idle
+ * account of every cog. */
+static void print_tasks() {
+  struct sched_task* t;
+  struct idle_stats* s;
+  unsigned int i;
+  int j;
+
+  for (i = 0; i < NUM_COGS; i++) {
+    for (j = 0; j < cogs[i].sched->num_tasks; j++) {
+      t = &cogs[i].sched->tasks[j];
+      printf("%-10s %-9s %6u runs %3u overruns, late <= %.3f ms\n", "",
+             cogs[i].tasks[j], t->runs, t->overruns,
+             t->late_max * 1000.0 / SIM_CLKFREQ);
+    }
+  }
+  for (i = 0; i < NUM_COGS; i++) {
+    s = &idle_mailbox[cogs[i].sched->cog].data;
+    printf("%-10s %-9s %8.1f s awake, %5.1f%% asleep in %u naps\n", "",
+           cogs[i].name, (double)s->awake / SIM_CLKFREQ,
+           100.0 * s->asleep / (s->awake + s->asleep + 1), s->naps);
+  }
+  printf("%-10s %u EEPROM page writes\n", "", eeprom_sim_writes);
+  printf("%-10s %.1f ms average conversion window\n", "",
+         (double)sensors_conversion_ms / sensors_sched.tasks[0].runs);
+  printf("%-10s %.2f ms 1-Wire bus time per sample\n", "",
+         ds18b20_sim_bus_us / 1000.0 / sensors_sched.tasks[0].runs);
+  for (i = 0; i < NUM_SENSORS; i++) {
+    printf("%-10s sensor %u: %u read errors, %u samples lost\n", "", i,
+           sensors[i].errors, sensors[i].failures);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const char* name = NULL;
+  int verbose = 0;
+  struct result r;
+  unsigned int i;
+  int j;
+
+  for (j = 1; j < argc; j++) {
+    if (!strcmp(argv[j], "-v")) {
+      verbose = 1;
+    } else if (!strcmp(argv[j], "-o") && j + 1 < argc) {
+      capture = fopen(argv[++j], "wb");
+      if (capture == NULL) {
+        perror(argv[j]);
+        return 1;
+      }
+    } else {
+      name = argv[j];
+    }
+  }
+
+  printf("%-10s %5s %8s %6s %5s %5s %7s %6s %7s %7s %6s %8s %5s %7s\n",
+         "scenario", "days", "heater", "heater", "runs", "run", "pump",
+         "band", "below", "above", "p.sw", "tx", "halt", "speedup");
+  printf("%-10s %5s %8s %6s %5s %5s %7s %6s %7s %7s %6s %8s %5s %7s\n",
+         "", "", "Wh", "Wh/Kh", "", "min", "Wh", "%", "C*h", "C*h", "",
+         "bytes", "", "x");
+  for (i = 0; i < NUM_SCENARIOS; i++) {
+    if (name && strcmp(name, scenarios[i].name)) {
+      continue;
+    }
+    /* The engine keeps its state in globals, one process per run. */
+    fflush(stdout);
+    if (fork()) {
+      wait(NULL);
+      continue;
+    }
+    run(&scenarios[i], &r);
+    printf("%-10s %5.1f %8.1f %6.2f %5u %5.1f %7.2f %6.1f %7.1f %7.1f %6u "
+           "%8lu %5d %7.0f\n",
+           scenarios[i].name, scenarios[i].days, r.heater_wh, r.wh_per_kh,
+           r.heater_runs, r.run_min, r.pump_wh, r.in_band, r.below, r.above,
+           r.pump_switches, r.telemetry_bytes, r.halt,
+           scenarios[i].days * 86400.0 / (r.wall > 0 ? r.wall : 1e-6));
+    if (r.halt) {
+      printf("%-10s halted with code %d on day %.2f\n", "", r.halt,
+             r.halt_day);
+    }
+    if (verbose) {
+      print_tasks();
+      printf("%-10s %lu XBee packets, %.1f bytes of frames each\n", "",
+             r.packets, r.packets ? (double)r.frame_bytes / r.packets : 0.0);
+    }
+    return 0;
+  }
+  return 0;
+}
@@ -0,0 +1,352 @@
+/*
+ * Vegimeter 2 host simulator: DS18B20 slaves on the 1-Wire pins
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "onewire_cog.h"
+#include "sim.h"
+
+#define MAX_DEVICES 32
+#define NUM_PINS 32
+
+/* Bus states after a reset. */
+#define BUS_IDLE 0
+#define BUS_ROM 1 /* Waiting for a ROM command */
+#define BUS_MATCH 2 /* Receiving a MATCH ROM ID */
+#define BUS_SEARCH 3
+#define BUS_FUNCTION 4 /* Waiting for a function command */
+#define BUS_READ 5 /* Sending the scratch pad */
+#define BUS_WRITE 6 /* Receiving TH, TL and the configuration */
+
+struct device {
+  uint8_t pin;
+  int probe;
+  uint8_t rom[8];
+  uint8_t sp[9];
+  int16_t pending; /* Raw reading of the conversion in progress */
+  uint64_t done; /* Conversion completes at this sim_time */
+};
+
+struct bus {
+  int state;
+  uint32_t selected; /* Mask of devices */
+  int index; /* Byte index of MATCH, READ and WRITE, bit step of SEARCH */
+  uint8_t match[8];
+};
+
+static struct device devices[MAX_DEVICES];
+static int num_devices = 0;
+static struct bus buses[NUM_PINS];
+
+/* Standard speed, microseconds. */
+#define RESET_US 960
+#define SLOT_US 70
+
+double ds18b20_sim_read_errors = 0;
+uint64_t ds18b20_sim_bus_us = 0;
+
+static uint8_t crc8(const uint8_t* data, int size) {
+  uint8_t crc = 0, b;
+  int i;
+
+  while (size--) {
+    b = *data++;
+    for (i = 0; i < 8; i++) {
+      crc = ((crc ^ b) & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+      b >>= 1;
+    }
+  }
+  return crc;
+}
+
+static int resolution(const struct device* d) {
+  return 9 + (d->sp[4] >> 5 & 3);
+}
+
+static uint64_t conversion_cycles(const struct device* d) {
+  /* 93.75 ms at 9 bits, doubling with every extra bit. */
+  return (uint64_t)(0.09375 * SIM_CLKFREQ) << (resolution(d) - 9);
+}
+
+static void set_temp(struct device* d, int16_t raw) {
+  d->sp[0] = raw & 0xFF;
+  d->sp[1] = (raw >> 8) & 0xFF;
+  d->sp[8] = crc8(d->sp, 8);
+}
+
+static int16_t sample(struct device* d) {
+  double t = plant_probe_temp(d->probe);
+  int16_t raw = (int16_t)(t * 16.0 + (t < 0 ? -0.5 : 0.5));
+
+  /* Undefined low bits read as zeros at lower resolutions. */
+  return raw & ~((1 << (12 - resolution(d))) - 1);
+}
+
+void ds18b20_sim_reset() {
+  num_devices = 0;
+  memset(buses, 0, sizeof(buses));
+  ds18b20_sim_bus_us = 0;
+}
+
+void ds18b20_sim_add(uint8_t pin, int probe) {
+  struct device* d = &devices[num_devices];
+  int i;
+
+  memset(d, 0, sizeof(*d));
+  d->pin = pin;
+  d->probe = probe;
+  d->rom[0] = 0x28;
+  for (i = 1; i < 7; i++) {
+    d->rom[i] = sim_rand() & 0xFF;
+  }
+  d->rom[7] = crc8(d->rom, 7);
+  d->sp[2] = 0x4B; /* TH */
+  d->sp[3] = 0x46; /* TL */
+  d->sp[4] = 0x7F; /* 12 bits */
+  d->sp[5] = 0xFF;
+  d->sp[6] = 0x0C;
+  d->sp[7] = 0x10;
+  set_temp(d, 85 * 16); /* Power-on value */
+  num_devices++;
+}
+
+void ds18b20_sim_power_on(int probe) {
+  int i;
+
+  for (i = 0; i < num_devices; i++) {
+    if (devices[i].probe == probe) {
+      /* The configuration comes back from the DS18B20's EEPROM, which
+       * the engine never writes. */
+      devices[i].sp[4] = 0x7F;
+      devices[i].done = 0;
+      set_temp(&devices[i], 85 * 16);
+    }
+  }
+}
+
+static uint32_t on_pin(uint8_t pin) {
+  uint32_t mask = 0;
+  int i;
+
+  for (i = 0; i < num_devices; i++) {
+    if (devices[i].pin == pin) {
+      mask |= 1UL << i;
+    }
+  }
+  return mask;
+}
+
+static void complete_conversions(uint32_t mask) {
+  int i;
+
+  for (i = 0; i < num_devices; i++) {
+    if ((mask >> i & 1) && devices[i].done && sim_time >= devices[i].done) {
+      set_temp(&devices[i], devices[i].pending);
+      devices[i].done = 0;
+    }
+  }
+}
+
+int8_t ow_reset(uint8_t pin) {
+  struct bus* b = &buses[pin];
+
+  sim_sync();
+  ds18b20_sim_bus_us += RESET_US;
+  complete_conversions(on_pin(pin));
+  b->state = BUS_ROM;
+  b->selected = 0;
+  b->index = 0;
+  /* 0 when a slave answered with a presence pulse. */
+  return on_pin(pin) ? 0 : 1;
+}
+
+static void function_command(struct bus* b, uint8_t command) {
+  int i;
+
+  switch (command) {
+  case 0x44: /* Convert */
+    for (i = 0; i < num_devices; i++) {
+      if (b->selected >> i & 1) {
+        devices[i].pending = sample(&devices[i]);
+        devices[i].done = sim_time + conversion_cycles(&devices[i]);
+      }
+    }
+    b->state = BUS_IDLE;
+    break;
+  case 0xBE: /* Read scratch pad */
+    b->state = BUS_READ;
+    b->index = 0;
+    break;
+  case 0x4E: /* Write scratch pad */
+    b->state = BUS_WRITE;
+    b->index = 0;
+    break;
+  default:
+    b->state = BUS_IDLE;
+  }
+}
+
+void ow_write_byte(uint8_t byte, uint8_t pin) {
+  struct bus* b = &buses[pin];
+  int i;
+
+  ds18b20_sim_bus_us += 8 * SLOT_US;
+  switch (b->state) {
+  case BUS_ROM:
+    if (byte == 0xCC) {
+      b->selected = on_pin(pin);
+      b->state = BUS_FUNCTION;
+    } else if (byte == 0x55) {
+      b->state = BUS_MATCH;
+      b->index = 0;
+    } else if (byte == 0xF0) {
+      b->selected = on_pin(pin);
+      b->state = BUS_SEARCH;
+      b->index = 0;
+    } else {
+      b->state = BUS_IDLE;
+    }
+    break;
+  case BUS_MATCH:
+    b->match[b->index++] = byte;
+    if (b->index == 8) {
+      for (i = 0; i < num_devices; i++) {
+        if (devices[i].pin == pin && !memcmp(devices[i].rom, b->match, 8)) {
+          b->selected |= 1UL << i;
+        }
+      }
+      b->state = BUS_FUNCTION;
+    }
+    break;
+  case BUS_FUNCTION:
+    function_command(b, byte);
+    break;
+  case BUS_WRITE:
+    for (i = 0; i < num_devices; i++) {
+      if (b->selected >> i & 1) {
+        devices[i].sp[2 + b->index] = byte;
+        devices[i].sp[8] = crc8(devices[i].sp, 8);
+      }
+    }
+    if (++b->index == 3) {
+      b->state = BUS_IDLE;
+    }
+    break;
+  }
+}
+
+void ow_command(uint8_t command, uint8_t pin) {
+  ow_write_byte(0xCC, pin);
+  ow_write_byte(command, pin);
+}
+
+uint8_t ow_read_byte(uint8_t pin) {
+  struct bus* b = &buses[pin];
+  uint8_t byte = 0xFF;
+  int i;
+
+  ds18b20_sim_bus_us += 8 * SLOT_US;
+  if (b->state != BUS_READ || b->index >= 9) {
+    return byte;
+  }
+  /* Wired AND of everybody who is talking. */
+  for (i = 0; i < num_devices; i++) {
+    if (b->selected >> i & 1) {
+      byte &= devices[i].sp[b->index];
+    }
+  }
+  b->index++;
+  if (ds18b20_sim_read_errors > 0 &&
+      sim_rand() < ds18b20_sim_read_errors * 4294967296.0) {
+    /* Noise on the line, one bit flipped. */
+    byte ^= 1 << (sim_rand() & 7);
+  }
+  return byte;
+}
+
+static int rom_bit(const struct device* d, int bit) {
+  return d->rom[bit >> 3] >> (bit & 7) & 1;
+}
+
+/*
+ * SEARCH ROM is a sequence of triplets: read the ROM bit, read its
+ * complement, write the direction. Slaves whose bit differs from the
+ * direction drop out until the next reset.
+ */
+uint8_t ow_read_bit(uint8_t pin) {
+  struct bus* b = &buses[pin];
+  int bit = b->index / 3, step = b->index % 3;
+  uint8_t v = 1;
+  int i;
+
+  ds18b20_sim_bus_us += SLOT_US;
+  if (b->state == BUS_SEARCH && step < 2) {
+    for (i = 0; i < num_devices; i++) {
+      if (b->selected >> i & 1) {
+        v &= step ? !rom_bit(&devices[i], bit) : rom_bit(&devices[i], bit);
+      }
+    }
+    b->index++;
+    return v;
+  }
+  /* Read time slots during a conversion return 0 until it is done. */
+  sim_sync();
+  for (i = 0; i < num_devices; i++) {
+    if (devices[i].pin == pin && devices[i].done && sim_time < devices[i].done) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void ow_write_bit(uint8_t v, uint8_t pin) {
+  struct bus* b = &buses[pin];
+  int bit = b->index / 3;
+  int i;
+
+  ds18b20_sim_bus_us += SLOT_US;
+  if (b->state != BUS_SEARCH || b->index % 3 != 2) {
+    return;
+  }
+  for (i = 0; i < num_devices; i++) {
+    if ((b->selected >> i & 1) && rom_bit(&devices[i], bit) != v) {
+      b->selected &= ~(1UL << i);
+    }
+  }
+  b->index++;
+  if (bit == 63) {
+    b->state = BUS_FUNCTION;
+  }
+}
+
+/* Lockstep primitives of the 1-Wire coprocessor, the pins share the time. */
+uint32_t ow_reset_pins(uint32_t mask) {
+  uint64_t us = ds18b20_sim_bus_us;
+  uint32_t presence = 0;
+  int pin;
+
+  for (pin = 0; pin < NUM_PINS; pin++) {
+    if ((mask >> pin & 1) && !ow_reset(pin)) {
+      presence |= 1UL << pin;
+    }
+  }
+  ds18b20_sim_bus_us = us + RESET_US;
+  return presence;
+}
+
+void ow_byte_pins(uint32_t mask, uint32_t read_mask, const uint8_t* out,
+                  uint8_t* in) {
+  uint64_t us = ds18b20_sim_bus_us;
+  int pin;
+
+  for (pin = 0; pin < NUM_PINS; pin++) {
+    if (read_mask >> pin & 1) {
+      in[pin] = ow_read_byte(pin);
+    } else if (mask >> pin & 1) {
+      ow_write_byte(out[pin], pin);
+    }
+  }
+  ds18b20_sim_bus_us = us + 8 * SLOT_US;
+}
@@ -0,0 +1,44 @@
+/*
+ * Vegimeter 2 host simulator: the 24LC512 boot EEPROM
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "eeprom.h"
+#include "sim.h"
+
+static uint8_t eeprom[EEPROM_SIZE];
+
+unsigned int eeprom_sim_writes = 0;
+
+void eeprom_sim_reset() {
+  /* Erased. */
+  memset(eeprom, 0xFF, sizeof(eeprom));
+  eeprom_sim_writes = 0;
+}
+
+void eeprom_init() {
+}
+
+void eeprom_release() {
+}
+
+int eeprom_read(uint16_t addr, uint8_t* data, uint16_t size) {
+  /* Sequential reads wrap around at the end of the chip. */
+  while (size--) {
+    *data++ = eeprom[addr++];
+  }
+  return 0;
+}
+
+int eeprom_write_page(uint16_t addr, const uint8_t* data, uint8_t size) {
+  uint16_t page = addr & ~(EEPROM_PAGE_SIZE - 1);
+
+  /* Writes wrap around within the page. */
+  while (size--) {
+    eeprom[page | (addr++ & (EEPROM_PAGE_SIZE - 1))] = *data++;
+  }
+  eeprom_sim_writes++;
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Vegimeter 2 host test of the control step
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ *
+ * engine_step() runs one polling period at a time on readings written
+ * straight into the sensors mailbox, as the sensing cog publishes them,
+ * and the test looks at what the control snapshot reports.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "hal.h"
+#include "engine.h"
+#include "sensors.h"
+#include "warm.h"
+#include "sim.h"
+
+static const struct scenario scenario = {
+  "test", 1, 10.0, 0, 0, 0, 15.0, 30.0, 0, 1
+};
+static int failures = 0;
+
+static void check(int ok, const char* what) {
+  printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+  failures += !ok;
+}
+
+/* Publishes the readings by probe kind, then runs a control step. */
+static struct control_snapshot* step(int air, int soil, int water) {
+  int8_t role;
+
+  mailbox_write_begin(&sensors_mailbox);
+  for (role = 0; role < NUM_SENSORS; role++) {
+    switch (sensor_config[role].kind) {
+    case SENSOR_KIND_AIR:
+      sensors_mailbox.data.temp[role] = air;
+      break;
+    case SENSOR_KIND_SOIL:
+      sensors_mailbox.data.temp[role] = soil;
+      break;
+    case SENSOR_KIND_WATER:
+      sensors_mailbox.data.temp[role] = water;
+      break;
+    }
+  }
+  mailbox_write_end(&sensors_mailbox);
+  engine_step();
+  return &control_mailbox.data;
+}
+
+static void test_heater() {
+  struct control_snapshot* c;
+  int i;
+
+  engine_init();
+
+  /* Full duty from the PI, the heater starts a run once the credit is
+   * worth it, on the third period. Until then the water is no warmer
+   * than the soil, so the pump stays off. */
+  for (i = 0; i < 2; i++) {
+    c = step(1000, 1500, 1500);
+  }
+  check(!c->heater && c->heater_duty > 0 && !c->pump &&
+        c->action == ACTION_HEAT_PUMP_OFF, "pump off while the duty adds up");
+  c = step(1000, 1500, 3000);
+  check(c->heater && c->heater_duty > 0 && c->pump &&
+        c->action == ACTION_HEATER_ON, "heater run started with the pump");
+  c = step(1000, 1500, 4250);
+  check(!c->heater && c->heater_duty == 0,
+        "run ended when the water crossed 42 C");
+  c = step(1000, 1500, 3000);
+  check(!c->heater, "no run left over after the water cooled");
+
+  /* A probe that stops answering halts, with the actuators off in the
+   * same period. */
+  for (i = 0; i < 3; i++) {
+    c = step(1000, 1500, 3000);
+  }
+  c = step(1000, DEFAULT_TEMP_READING, 3000);
+  check(c->halt == ERROR_BAD_TEMP && !c->heater && !c->pump,
+        "heater and pump off at a bad reading");
+}
+
+/* Half a degree under the setpoint, the P term alone asks for 400
+ * permille, while the water is too hot for 100 periods. */
+static void test_windup() {
+  struct control_snapshot* c;
+  int i;
+
+  engine_init();
+  for (i = 0; i < 100; i++) {
+    c = step(1000, SOIL_SETPOINT - 50, 4250);
+  }
+  check(c->heater_duty == 0, "heater held off by the hot water");
+  c = step(1000, SOIL_SETPOINT - 50, 3000);
+  check(c->heater_duty > 0 && c->heater_duty < 450,
+        "no integral wound up meanwhile");
+}
+
+/* A reset in the middle of a heater run, with some on-time over the
+ * rest allowance. */
+static void test_warm() {
+  struct control_snapshot* c = &control_mailbox.data;
+  int8_t role;
+
+  for (role = 0; role < NUM_SENSORS; role++) {
+    c->temp[role] = 2000;
+  }
+  c->heater = 1;
+  c->pump = 1;
+  c->action = ACTION_HEATER_ON;
+  c->heater_duty = 1000;
+  c->heater_run = 1;
+  c->heater_excess = 45500;
+  warm_save(c);
+  memset(c, 0, sizeof(*c));
+
+  engine_init();
+  sim_sync();
+  check(plant.heater && plant.pump, "heater run and pump back at boot");
+  c = step(1000, 1500, 3000);
+  check(c->heater && c->heater_run == 0, "run carried on after the reset");
+  check(c->heater_excess == 75500 && c->heater_periods == 2,
+        "heater excess kept to the millisecond");
+}
+
+/* The engine keeps its state in globals, one process per test. */
+static void run(void (*test)()) {
+  int status;
+
+  fflush(stdout);
+  if (fork() == 0) {
+    sim_reset();
+    plant_init(&scenario);
+    eeprom_sim_reset();
+    test();
+    exit(failures > 0);
+  }
+  wait(&status);
+  failures += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+int main() {
+  run(test_heater);
+  run(test_windup);
+  run(test_warm);
+  return failures > 0;
+}
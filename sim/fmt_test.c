@@ -0,0 +1,61 @@
+/*
+ * Vegimeter 2 host test of the formatting
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "fmt.h"
+
+static int failures = 0;
+
+/* The text from line to end must be want, and end its NUL. */
+static void check(const char* line, const char* end, const char* want) {
+  int ok = !strcmp(line, want) && end == line + strlen(want);
+
+  printf("%-16s %s\n", want, ok ? "ok" : "FAILED");
+  if (!ok) {
+    printf("  got \"%s\", %d chars\n", line, (int)(end - line));
+    failures++;
+  }
+}
+
+int main() {
+  char line[64];
+  char* p;
+
+  check(line, fmt_str(line, ""), "");
+  check(line, fmt_str(line, "soil "), "soil ");
+
+  check(line, fmt_uint(line, 0), "0");
+  check(line, fmt_uint(line, 7), "7");
+  check(line, fmt_uint(line, 4294967295U), "4294967295");
+
+  check(line, fmt_int(line, 0), "0");
+  check(line, fmt_int(line, -1), "-1");
+  check(line, fmt_int(line, 2147483647), "2147483647");
+  check(line, fmt_int(line, INT32_MIN), "-2147483648");
+
+  check(line, fmt_hex(line, 0x2A, 2), "2A");
+  check(line, fmt_hex(line, 0x2A, 4), "002A");
+  check(line, fmt_hex(line, 0xDEADBEEF, 4), "BEEF");
+  check(line, fmt_hex(line, 0xDEADBEEF, 8), "DEADBEEF");
+
+  check(line, fmt_centi(line, 2110), "21.10");
+  check(line, fmt_centi(line, 5), "0.05");
+  check(line, fmt_centi(line, 0), "0.00");
+  check(line, fmt_centi(line, -5), "-0.05");
+  check(line, fmt_centi(line, -2110), "-21.10");
+  check(line, fmt_centi(line, INT32_MIN), "-21474836.48");
+
+  /* Calls chain. */
+  p = fmt_str(line, "soil ");
+  p = fmt_centi(p, 2110);
+  p = fmt_str(p, " pump ");
+  p = fmt_hex(p, 1, 2);
+  check(line, p, "soil 21.10 pump 01");
+
+  return failures > 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Vegimeter 2 host HAL: virtual CNT and pin registers
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "engine.h"
+#include "sim.h"
+
+volatile uint32_t hal_cnt;
+volatile uint32_t hal_ina;
+volatile uint32_t hal_outa;
+volatile uint32_t hal_dira;
+unsigned int _clkfreq = SIM_CLKFREQ;
+
+uint64_t sim_time = 0;
+int sim_nap = 0;
+uint64_t sim_wake = 0;
+static uint64_t plant_time = 0;
+
+/* DIRA and OUTA as of plant_time. */
+static uint32_t pins_dir, pins_out;
+
+/*
+ * Counters in NCO single-ended mode: APIN follows bit 31 of PHSx, which
+ * was phs at cycle t0 and adds frq every cycle since.
+ */
+struct ctr {
+  uint32_t mode;
+  uint32_t frq;
+  uint32_t phs;
+  uint64_t t0;
+};
+
+#define CTR_NCO_SINGLE 4
+
+static struct ctr ctrs[2];
+
+double sim_seconds() {
+  return (double)sim_time / SIM_CLKFREQ;
+}
+
+static int ctr_running(const struct ctr* c) {
+  return (c->mode >> 26 & 0x1F) == CTR_NCO_SINGLE;
+}
+
+static uint32_t ctr_phs(const struct ctr* c, uint64_t t) {
+  return c->phs + c->frq * (uint32_t)(t - c->t0);
+}
+
+/* Cycle of the next output edge after t, or ~0. */
+static uint64_t ctr_next_edge(const struct ctr* c, uint64_t t) {
+  uint32_t phs = ctr_phs(c, t);
+  uint32_t left = (phs & 0x80000000UL) ? -phs : 0x80000000UL - phs;
+
+  if (!ctr_running(c) || c->frq == 0) {
+    return ~(uint64_t)0;
+  }
+  return t + (left + c->frq - 1) / c->frq;
+}
+
+static int pin_is_high(int pin, uint64_t t) {
+  uint32_t out = pins_out;
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    if (ctr_running(&ctrs[i]) && (ctr_phs(&ctrs[i], t) >> 31)) {
+      out |= 1UL << (ctrs[i].mode & 0x1F);
+    }
+  }
+  return (pins_dir & out) >> pin & 1;
+}
+
+/* Gives the plant the pin states at plant_time. */
+static void sim_set_actuators() {
+  int heater = pin_is_high(HEATER, plant_time);
+  int pump = pin_is_high(PUMP, plant_time);
+
+  plant.heater_runs += heater && !plant.heater;
+  plant.heater_switches += heater != plant.heater;
+  plant.pump_switches += pump != plant.pump;
+  plant.heater = heater;
+  plant.pump = pump;
+}
+
+void sim_sync() {
+  uint64_t end, edge;
+  int i;
+
+  while (plant_time < sim_time) {
+    sim_set_actuators();
+    end = plant_time + (uint64_t)(SIM_STEP * SIM_CLKFREQ);
+    if (end > sim_time) {
+      end = sim_time;
+    }
+    /* Counter edges split the steps. */
+    for (i = 0; i < 2; i++) {
+      edge = ctr_next_edge(&ctrs[i], plant_time);
+      if (edge < end) {
+        end = edge;
+      }
+    }
+    plant_step((double)(end - plant_time) / SIM_CLKFREQ);
+    plant_time = end;
+  }
+  sim_set_actuators();
+}
+
+/*
+ * The engine code runs in zero simulated time, so the pins can only change
+ * between two waits. The plant gets the new pin states from now on.
+ */
+static void sim_check_actuators() {
+  if ((hal_dira & hal_outa) == (pins_dir & pins_out) &&
+      hal_dira == pins_dir) {
+    return;
+  }
+  sim_sync();
+  pins_dir = hal_dira;
+  pins_out = hal_outa;
+  sim_set_actuators();
+}
+
+void hal_ctr_write(int ctr, uint32_t mode, uint32_t frq, uint32_t phs) {
+  struct ctr* c = &ctrs[ctr ? 1 : 0];
+
+  /* The plant had the old counter up to now. */
+  sim_check_actuators();
+  sim_sync();
+  c->mode = mode;
+  c->frq = frq;
+  c->phs = phs;
+  c->t0 = sim_time;
+  sim_set_actuators();
+}
+
+void sim_advance_to(uint64_t cycles) {
+  sim_check_actuators();
+  if (cycles > sim_time) {
+    sim_time = cycles;
+    hal_cnt = (uint32_t)sim_time;
+  }
+  if (sim_time - plant_time >= (uint64_t)(SIM_STEP * SIM_CLKFREQ)) {
+    sim_sync();
+  }
+}
+
+void sim_reset() {
+  sim_time = plant_time = 0;
+  hal_cnt = hal_ina = hal_outa = hal_dira = 0;
+  pins_dir = pins_out = 0;
+  memset(ctrs, 0, sizeof(ctrs));
+}
+
+void __napuntil(unsigned int t) {
+  int32_t d = (int32_t)(t - hal_cnt);
+
+  if (sim_nap) {
+    sim_wake = sim_time + (d > 0 ? d : 0);
+    hal_cnt = t;
+    return;
+  }
+  sim_advance_to(sim_time + (d > 0 ? d : 0));
+}
+
+int cogstart(void (*func)(void*), void* par, void* stack, size_t stacksize) {
+  static int cog = 0;
+
+  return ++cog;
+}
@@ -0,0 +1,91 @@
+/*
+ * Vegimeter 2 host test of the thermal model
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ *
+ * The model learns a noiseless plant with the structure of model.h, then a
+ * second one restarts warm with its parameters and must keep them while
+ * its own estimators only see an equilibrium that tells nothing apart.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hal.h"
+#include "model.h"
+
+#define AIR 800 /* Centi-Celsius */
+#define SOIL_AIR 0.0024
+#define SOIL_WATER 0.0072
+#define WATER_HEATER 0.24
+#define WATER_AIR 0.01
+#define WATER_SOIL 0.06
+
+static int failures = 0;
+
+static void check(int ok, const char* what) {
+  printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+  failures += !ok;
+}
+
+/* Within 10% of the plant constant. */
+static int near(int32_t theta, double want) {
+  double got = theta / (double)(1 << RLS_Q);
+
+  return got > want * 0.9 && got < want * 1.1;
+}
+
+/* One polling period of the plant, the duty and the air following slow
+ * square waves so that the regressors vary. */
+static void plant_period(struct model* m, double* soil, double* water,
+                         int period) {
+  int duty = period / 90 % 2 ? 200 : 0;
+  int air = period / 400 % 2 ? AIR - 500 : AIR + 500;
+
+  model_step(m, air, (int)(*soil + 0.5), (int)(*water + 0.5), duty, 1);
+  *soil += SOIL_AIR * (air - *soil) + SOIL_WATER * (*water - *soil);
+  *water += WATER_HEATER * duty + WATER_AIR * (air - *water) +
+    WATER_SOIL * (*soil - *water);
+}
+
+int main() {
+  static struct model cold, warm;
+  double soil = 2100, water = 2100;
+  int32_t soil_theta[RLS_N], water_theta[RLS_N];
+  int i, kept = 1;
+
+  model_init(&cold);
+  for (i = 0; i < 200 * MODEL_PERIODS; i++) {
+    plant_period(&cold, &soil, &water, i);
+  }
+  check(model_valid(&cold), "cold start valid after 200 samples");
+  check(near(cold.soil.theta[MODEL_SOIL_AIR], SOIL_AIR) &&
+        near(cold.soil.theta[MODEL_SOIL_WATER], SOIL_WATER) &&
+        near(cold.water.theta[MODEL_WATER_HEATER], WATER_HEATER),
+        "cold start parameters within 10%");
+
+  memcpy(soil_theta, cold.soil.theta, sizeof(soil_theta));
+  memcpy(water_theta, cold.water.theta, sizeof(water_theta));
+  model_init(&warm);
+  model_warm(&warm, soil_theta, water_theta);
+  check(model_valid(&warm), "warm start valid right away");
+
+  /* All at the same temperature, the heater off: the normal equations
+   * only see the bias. */
+  for (i = 0; i < (MODEL_MIN_SAMPLES - 1) * MODEL_PERIODS; i++) {
+    model_step(&warm, 2100, 2100, 2100, 0, 1);
+    kept &= !memcmp(warm.soil.theta, soil_theta, sizeof(soil_theta)) &&
+      !memcmp(warm.water.theta, water_theta, sizeof(water_theta));
+  }
+  check(kept && model_valid(&warm), "warm parameters kept in an equilibrium");
+
+  soil = water = 2100;
+  for (i = 0; i < 200 * MODEL_PERIODS; i++) {
+    plant_period(&warm, &soil, &water, i);
+  }
+  check(!warm.warm && model_valid(&warm) &&
+        near(warm.soil.theta[MODEL_SOIL_AIR], SOIL_AIR) &&
+        near(warm.water.theta[MODEL_WATER_HEATER], WATER_HEATER),
+        "own estimates taken over after the samples");
+
+  return failures > 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Vegimeter 2 host simulator: lumped thermal plant
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include <math.h>
+#include <string.h>
+#include "sim.h"
+
+/*
+ * Two thermal masses, the potting soil and the water tank, and the ambient
+ * air as an infinite source. The heater (a 12V RoadPro hot pot) heats the
+ * water, the pump circulates the water through a coil in the soil.
+ */
+#define SOIL_CAPACITY 25000.0 /* J/K, about 10 l of wet potting soil */
+#define WATER_CAPACITY 3000.0 /* J/K, 0.6 l of water and the pot */
+#define HEATER_POWER 120.0 /* W */
+#define PUMP_POWER 1.8 /* W, 300 mA at 6 V */
+#define WATER_SOIL_PUMP_ON 3.0 /* W/K through the coil */
+#define WATER_SOIL_PUMP_OFF 0.3 /* W/K */
+#define SOIL_AIR 1.0 /* W/K */
+#define WATER_AIR 0.5 /* W/K */
+
+/* Soil band used for the time-in-band figures, C. */
+#define BAND_LOW 20.5
+#define BAND_HIGH 23.5
+/* The heat the soil needs goes with the air below this, C. */
+#define SETPOINT 21.0
+
+/* Fixed offsets between the soil probes, C. */
+static const double soil_offsets[4] = { -0.3, 0.1, 0.2, 0.0 };
+
+struct plant plant;
+static const struct scenario* scenario;
+static unsigned int rand_state;
+
+unsigned int sim_rand() {
+  /* xorshift32 */
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+double sim_noise(double sigma) {
+  /* Sum of uniforms, close enough to a gaussian here. */
+  double u = 0;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    u += (double)sim_rand() / 4294967296.0;
+  }
+  return sigma * (u - 2.0) * 1.7320508;
+}
+
+static double ambient(double t) {
+  double day = t / 86400.0;
+  double a = scenario->ambient_mean +
+    scenario->ambient_swing * sin(2 * M_PI * (day - 0.375));
+
+  if (scenario->snap_day > 0 && day >= scenario->snap_day) {
+    a -= scenario->snap_drop;
+  }
+  return a;
+}
+
+void plant_init(const struct scenario* s) {
+  scenario = s;
+  rand_state = 2463534242U ^ s->seed;
+  memset(&plant, 0, sizeof(plant));
+  plant.soil = s->soil_start;
+  plant.water = s->water_start;
+  plant.air = ambient(0);
+}
+
+void plant_step(double dt) {
+  double ws = plant.pump ? WATER_SOIL_PUMP_ON : WATER_SOIL_PUMP_OFF;
+  double q_ws = ws * (plant.water - plant.soil);
+  double q_heater = plant.heater ? HEATER_POWER : 0.0;
+
+  plant.air = ambient(plant.t);
+  plant.water += dt * (q_heater - q_ws -
+                       WATER_AIR * (plant.water - plant.air)) / WATER_CAPACITY;
+  plant.soil += dt * (q_ws - SOIL_AIR * (plant.soil - plant.air)) /
+    SOIL_CAPACITY;
+  plant.t += dt;
+
+  plant.heater_energy += dt * q_heater;
+  plant.heater_on += plant.heater ? dt : 0.0;
+  plant.pump_energy += dt * (plant.pump ? PUMP_POWER : 0.0);
+  if (plant.air < SETPOINT) {
+    plant.demand += dt * (SETPOINT - plant.air);
+  }
+  if (plant.soil < BAND_LOW) {
+    plant.below_band += dt * (BAND_LOW - plant.soil);
+  } else if (plant.soil > BAND_HIGH) {
+    plant.above_band += dt * (plant.soil - BAND_HIGH);
+  } else {
+    plant.in_band += dt;
+  }
+}
+
+double plant_probe_temp(int probe) {
+  switch (probe) {
+  case PROBE_AIR:
+    return plant.air + sim_noise(0.05);
+  case PROBE_SOIL_A:
+  case PROBE_SOIL_B:
+  case PROBE_SOIL_C:
+  case PROBE_SOIL_D:
+    return plant.soil + soil_offsets[probe - PROBE_SOIL_A] + sim_noise(0.03);
+  case PROBE_WATER_A:
+    return plant.water + 0.1 + sim_noise(0.03);
+  case PROBE_WATER_B:
+    return plant.water - 0.1 + sim_noise(0.03);
+  }
+  return 85.0;
+}
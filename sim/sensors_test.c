@@ -0,0 +1,75 @@
+/*
+ * Vegimeter 2 host test of the sensors acquisition
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ *
+ * The sensing cog's conversion and reading run on simulated DS18B20, with
+ * the plant at rest, and a probe resets between the two.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hal.h"
+#include "sensors.h"
+#include "sim.h"
+
+static const struct scenario scenario = {
+  "test", 1, 10.0, 0, 0, 0, 20.0, 30.0, 0, 1
+};
+static int failures = 0;
+
+static void check(int ok, const char* what) {
+  printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+  failures += !ok;
+}
+
+/* Converts, sleeps through the window and reads, as the sensing cog
+ * does. The probe resets after the conversion unless it is -1. */
+static void sample(int reset) {
+  unsigned int ms = sensors_start_conversion();
+
+  sim_advance_to(sim_time + (uint64_t)ms * (SIM_CLKFREQ / 1000));
+  if (reset >= 0) {
+    ds18b20_sim_power_on(reset);
+  }
+  sensors_read_all();
+}
+
+int main() {
+  int i, before;
+
+  sim_reset();
+  plant_init(&scenario);
+  ds18b20_sim_reset();
+  for (i = 0; i < NUM_PROBES; i++) {
+    ds18b20_sim_add(sensor_config[i].pin, i);
+  }
+  sensors_init();
+
+  for (i = 0; i < 3; i++) {
+    sample(-1);
+  }
+  before = sensors_get_temp(SENSOR_AIR);
+  check(sensors[SENSOR_AIR].status == SENSOR_OK &&
+        abs(before - 1000) < 50, "air read at 10 C");
+
+  /* The fast read sees the power-on value and falls back on the full
+   * one, whose CRC is good. */
+  sample(PROBE_AIR);
+  check(sensors[SENSOR_AIR].status == SENSOR_READ_FAILED &&
+        sensors_get_temp(SENSOR_AIR) == before,
+        "power-on value lost, previous reading kept");
+
+  /* Read in full again, at the power-on resolution. */
+  sample(PROBE_AIR);
+  check(sensors[SENSOR_AIR].status == SENSOR_READ_FAILED &&
+        sensors_get_temp(SENSOR_AIR) == before,
+        "power-on value lost on the full read");
+
+  sample(-1);
+  check(sensors[SENSOR_AIR].status == SENSOR_OK &&
+        abs(sensors_get_temp(SENSOR_AIR) - 1000) < 50,
+        "air read again after a new conversion");
+
+  return failures > 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_SIM_H
+#define __VEGIMETER2_SIM_H
+
+#include <stdint.h>
+
+/*
+ * Host simulator for the Vegimeter 2 engine. The engine sources are built
+ * with VEGIMETER_HOST (see src/hal.h) against a virtual CNT, simulated
+ * DS18B20 on the 1-Wire pins and a lumped thermal plant that reads the
+ * heater and pump pins.
+ */
+
+#define SIM_CLKFREQ 80000000
+/* Longest plant integration step, seconds. */
+#define SIM_STEP 1.0
+
+/* Probes, i.e. what a simulated DS18B20 measures. */
+#define PROBE_AIR 0
+#define PROBE_SOIL_A 1
+#define PROBE_SOIL_B 2
+#define PROBE_SOIL_C 3
+#define PROBE_SOIL_D 4
+#define PROBE_WATER_A 5
+#define PROBE_WATER_B 6
+#define NUM_PROBES 7
+
+struct scenario {
+  const char* name;
+  double days;
+  double ambient_mean; /* C */
+  double ambient_swing; /* C, amplitude of the daily sine */
+  double snap_day; /* A cold snap starts that day, 0 for none */
+  double snap_drop; /* C */
+  double soil_start; /* C */
+  double water_start; /* C */
+  double read_errors; /* Probability that a byte read on the 1-Wire is bad */
+  unsigned int seed;
+};
+
+/* Plant state and the benchmark counters. */
+struct plant {
+  double t; /* Seconds since start */
+  double soil; /* C */
+  double water; /* C */
+  double air; /* C */
+  int heater;
+  int pump;
+  /* Counters */
+  double heater_energy; /* J */
+  double heater_on; /* Seconds */
+  double pump_energy; /* J */
+  double in_band; /* Seconds with the soil in the band */
+  double below_band; /* C * s below the band */
+  double above_band; /* C * s above the band */
+  double demand; /* C * s of air below the setpoint */
+  unsigned int heater_runs;
+  unsigned int heater_switches;
+  unsigned int pump_switches;
+};
+
+extern struct plant plant;
+extern uint64_t sim_time; /* Cycles */
+
+double sim_seconds();
+/* Advances the virtual time, integrates the plant lazily. */
+void sim_advance_to(uint64_t cycles);
+/* Integrates the plant up to sim_time. */
+void sim_sync();
+void sim_reset();
+/*
+ * The simulated cogs take turns, so a cog's nap between two scheduler
+ * polls cannot hold up the others. While sim_nap is set __napuntil() only
+ * books the wake-up in sim_wake and shows the napping cog CNT at it; the
+ * bench puts the cog back at that time. Other waits advance the time.
+ */
+extern int sim_nap;
+extern uint64_t sim_wake; /* Cycles */
+
+/* Also seeds sim_rand() with the seed of the scenario. */
+void plant_init(const struct scenario* scenario);
+void plant_step(double dt);
+double plant_probe_temp(int probe);
+
+void ds18b20_sim_reset();
+void ds18b20_sim_add(uint8_t pin, int probe);
+/* The DS18B20 of the probe resets, its scratch pad as at power-on. */
+void ds18b20_sim_power_on(int probe);
+/* Settings and counters of the simulated 1-Wire buses. */
+extern double ds18b20_sim_read_errors;
+extern uint64_t ds18b20_sim_bus_us; /* Time slots and resets */
+
+/* EEPROM page writes since the reset. */
+extern unsigned int eeprom_sim_writes;
+void eeprom_sim_reset();
+
+unsigned int sim_rand();
+double sim_noise(double sigma);
+
+#endif /* __VEGIMETER2_SIM_H */
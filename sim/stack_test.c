@@ -0,0 +1,65 @@
+/*
+ * Vegimeter 2 host test of the stack high-water marks
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ *
+ * The bench never runs code on the cogs' stacks, so here a function runs
+ * on a painted stack of its own, switched to with ucontext, and
+ * stack_used() has to find at least the frame it wrote and no more than
+ * the stack.
+ */
+
+#include <stdio.h>
+#include <ucontext.h>
+#include "hal.h"
+#include "stack.h"
+
+#define STACK_INTS 4096
+#define DEPTH_BYTES 2048
+
+static int stack[STACK_INTS];
+static ucontext_t main_context, cog_context;
+static int failures = 0;
+
+static void check(int ok, const char* what, unsigned int used) {
+  printf("%-36s %5u bytes %s\n", what, used, ok ? "ok" : "FAILED");
+  failures += !ok;
+}
+
+/* Writes DEPTH_BYTES of its frame. */
+static void cog() {
+  volatile char frame[DEPTH_BYTES];
+  unsigned int i;
+
+  for (i = 0; i < sizeof(frame); i++) {
+    frame[i] = (char)i;
+  }
+}
+
+int main() {
+  unsigned int used;
+
+  stack_paint(stack, sizeof(stack));
+  check(stack_used(stack, sizeof(stack)) == 0, "painted", 0);
+
+  /* Words written at the top and below are the depth. */
+  stack[STACK_INTS - 1] = 0;
+  check(stack_used(stack, sizeof(stack)) == sizeof(int), "top word",
+        stack_used(stack, sizeof(stack)));
+  stack[STACK_INTS - 10] = 0;
+  check(stack_used(stack, sizeof(stack)) == 10 * sizeof(int), "gap",
+        stack_used(stack, sizeof(stack)));
+
+  stack_paint(stack, sizeof(stack));
+  getcontext(&cog_context);
+  cog_context.uc_stack.ss_sp = stack;
+  cog_context.uc_stack.ss_size = sizeof(stack);
+  cog_context.uc_link = &main_context;
+  makecontext(&cog_context, cog, 0);
+  swapcontext(&main_context, &cog_context);
+  used = stack_used(stack, sizeof(stack));
+  check(used >= DEPTH_BYTES && used < sizeof(stack), "function on the stack",
+        used);
+
+  return failures > 0;
+}
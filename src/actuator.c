@@ -0,0 +1,118 @@
+/*
+ * Vegimeter 2 counter PWM actuator driver
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "actuator.h"
+#include "pins.h"
+
+#define CTR_NCO_SINGLE (4UL << 26) /* CTRMODE %00100, APIN in bits 5..0 */
+#define PHS_ON 0x80000000UL /* The pin follows the PHSx sign bit */
+
+static void arm(struct actuator* a, uint32_t frq, uint32_t phs) {
+  hal_ctr_write(a->ctr, CTR_NCO_SINGLE | a->pin, frq, phs);
+}
+
+/* Pulse length of a period, after min_on and min_off. */
+static unsigned int pulse_ms(struct actuator* a) {
+  unsigned int on = (unsigned int)a->duty * a->period / ACTUATOR_DUTY_MAX;
+
+  if (on < a->min_on) {
+    return 0;
+  }
+  if (on + a->min_off > a->period) {
+    return a->period;
+  }
+  return on;
+}
+
+/*
+ * Arms the counter for the next window of the period: fully on (the sign
+ * bit stays set with FRQx = 0), fully off, or on until PHSx counts up from
+ * -on to 0.
+ */
+static void arm_window(struct actuator* a) {
+  unsigned int millisecond = CLKFREQ / 1000;
+  unsigned int window = a->period - a->elapsed;
+  unsigned int on = a->on_ms > a->elapsed ? a->on_ms - a->elapsed : 0;
+
+  if (window > ACTUATOR_WINDOW_MS) {
+    window = ACTUATOR_WINDOW_MS;
+  }
+  if (on >= window) {
+    arm(a, 0, PHS_ON);
+  } else if (on > 0) {
+    arm(a, 1, -(on * millisecond));
+  } else {
+    arm(a, 0, 0);
+  }
+  a->elapsed += window;
+  a->next += window * millisecond;
+}
+
+static void start_period(struct actuator* a) {
+  if (a->ramp && a->target > a->duty + a->ramp) {
+    a->duty += a->ramp;
+  } else {
+    a->duty = a->target;
+  }
+  a->on_ms = pulse_ms(a);
+  a->elapsed = 0;
+  arm_window(a);
+  /* Fully on or off, and staying so: the counter needs nothing more. */
+  a->armed = a->duty != a->target ||
+    (a->on_ms > 0 && a->on_ms < a->period);
+}
+
+void actuator_init(struct actuator* a, uint8_t pin, uint8_t ctr,
+                   unsigned int period, unsigned int min_on,
+                   unsigned int min_off, uint16_t ramp) {
+  memset(a, 0, sizeof(*a));
+  a->pin = pin;
+  a->ctr = ctr;
+  a->period = period;
+  a->min_on = min_on;
+  a->min_off = min_off;
+  a->ramp = ramp;
+  /* The counter output is ORed with OUTA. */
+  OUT_LOW(pin);
+  DIR_OUTPUT(pin);
+  arm(a, 0, 0);
+}
+
+void actuator_set(struct actuator* a, int duty) {
+  if (duty < 0) {
+    duty = 0;
+  } else if (duty > ACTUATOR_DUTY_MAX) {
+    duty = ACTUATOR_DUTY_MAX;
+  }
+  a->target = duty;
+  a->next = CNT;
+  start_period(a);
+}
+
+void actuator_off(struct actuator* a) {
+  arm(a, 0, 0);
+  a->target = a->duty = 0;
+  a->on_ms = 0;
+  a->armed = 0;
+}
+
+unsigned int actuator_poll(struct actuator* a) {
+  unsigned int millisecond = CLKFREQ / 1000;
+  int32_t left;
+
+  while (a->armed && (left = (int32_t)(a->next - CNT)) <= 0) {
+    if (a->elapsed >= a->period) {
+      start_period(a);
+    } else {
+      arm_window(a);
+    }
+  }
+  if (!a->armed) {
+    return ACTUATOR_IDLE;
+  }
+  return (left + millisecond - 1) / millisecond;
+}
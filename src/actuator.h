@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_ACTUATOR_H
+#define __VEGIMETER2_ACTUATOR_H
+
+#include <stdint.h>
+
+/* Duty cycle full scale, permille. */
+#define ACTUATOR_DUTY_MAX 1000
+
+/* The counters of the calling cog. */
+#define ACTUATOR_CTRA 0
+#define ACTUATOR_CTRB 1
+
+/*
+ * Longest time between two re-arms of a counter, milliseconds. With
+ * FRQx = 1 the PHSx sign bit can time up to 2^31 cycles, 26.8 s at 80 MHz;
+ * the rest is slack for a late re-arm.
+ */
+#define ACTUATOR_WINDOW_MS 20000
+
+/* actuator_poll() result when no re-arm is pending. */
+#define ACTUATOR_IDLE 0xFFFFFFFFU
+
+/*
+ * Slow PWM output on a cog counter in NCO single-ended mode. Every period
+ * starts with a pulse of duty * period, the counter ends it by itself: the
+ * cog only writes FRQx and PHSx once per window, at most every
+ * ACTUATOR_WINDOW_MS, and not at all while the output is fully on or off.
+ * Longer periods are split in several windows.
+ *
+ * Pulses shorter than min_on are dropped and gaps shorter than min_off are
+ * filled, to protect the relay. When ramp is set the duty cycle rises by
+ * at most that much per period (soft-start); it always drops right away.
+ *
+ * The counters belong to a cog, so an actuator must only be used from
+ * the cog that called actuator_init().
+ */
+struct actuator {
+  uint8_t pin;
+  uint8_t ctr; /* ACTUATOR_CTRA or ACTUATOR_CTRB */
+  uint16_t ramp; /* Permille per period, 0 for none */
+  unsigned int period; /* Milliseconds */
+  unsigned int min_on; /* Milliseconds */
+  unsigned int min_off; /* Milliseconds */
+  int16_t target; /* Permille */
+  int16_t duty; /* Permille, the target after the ramp */
+  unsigned int on_ms; /* Pulse length of the current period */
+  unsigned int elapsed; /* Milliseconds of the period armed so far */
+  uint32_t next; /* CNT of the next re-arm */
+  int8_t armed; /* A re-arm is pending */
+};
+
+void actuator_init(struct actuator* a, uint8_t pin, uint8_t ctr,
+                   unsigned int period, unsigned int min_on,
+                   unsigned int min_off, uint16_t ramp);
+/* Sets the duty cycle, in permille, and starts a new period now. */
+void actuator_set(struct actuator* a, int duty);
+/* Switches the output off right away, regardless of min_on. */
+void actuator_off(struct actuator* a);
+/* Re-arms the counter when due. Returns the milliseconds to the next
+ * re-arm, or ACTUATOR_IDLE. */
+unsigned int actuator_poll(struct actuator* a);
+
+#endif /* __VEGIMETER2_ACTUATOR_H */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_BUTTON_RING_H
+#define __VEGIMETER2_BUTTON_RING_H
+
+#include <stdint.h>
+#include "mailbox.h"
+
+/* Must be a power of two. */
+#define BUTTON_RING_SIZE 32
+#define BUTTON_RING_MASK (BUTTON_RING_SIZE - 1)
+
+#define BUTTON_RELEASE 0
+#define BUTTON_PRESS 1
+
+struct button_event {
+  uint32_t cnt; /* CNT when the edge was seen */
+  uint8_t button; /* 0 to 7, P0 to P7 */
+  uint8_t edge; /* BUTTON_PRESS or BUTTON_RELEASE */
+};
+
+/*
+ * Button event ring in hub RAM, one producer cog and one consumer cog.
+ * Each index is only written by its own side, with one hub long write, so
+ * neither side ever waits for the other or needs a lock. The producer
+ * fills the event before it moves head, the consumer copies it out before
+ * it moves tail.
+ *
+ * Events are only lost if the consumer falls BUTTON_RING_SIZE events
+ * behind. The producer then drops the new ones and counts them.
+ */
+struct button_ring {
+  volatile uint32_t head; /* Moved by the producer */
+  volatile uint32_t tail; /* Moved by the consumer */
+  volatile uint32_t dropped;
+  struct button_event buf[BUTTON_RING_SIZE];
+};
+
+/*
+ * Producer side, empties the ring before the first event. Only head is
+ * written, so the consumer may already be running. Needed when the ring
+ * lives in memory that is not cleared at boot.
+ */
+static inline void button_ring_reset(struct button_ring* r) {
+  r->dropped = 0;
+  mailbox_barrier();
+  r->head = r->tail;
+}
+
+/* Producer side. Returns 0, or -1 if the ring was full. */
+static inline int button_ring_put(struct button_ring* r, uint8_t button,
+                                  uint8_t edge, uint32_t cnt) {
+  uint32_t head = r->head;
+  struct button_event* e;
+
+  if (head - r->tail >= BUTTON_RING_SIZE) {
+    r->dropped++;
+    return -1;
+  }
+  e = &r->buf[head & BUTTON_RING_MASK];
+  e->cnt = cnt;
+  e->button = button;
+  e->edge = edge;
+  mailbox_barrier();
+  r->head = head + 1;
+  return 0;
+}
+
+/*
+ * Consumer side, copies out up to max events in order and returns how
+ * many. Indices more than BUTTON_RING_SIZE apart, as in a ring that its
+ * producer did not reset yet, read as empty.
+ */
+static inline int button_ring_drain(struct button_ring* r,
+                                    struct button_event* events, int max) {
+  uint32_t tail = r->tail;
+  uint32_t n = r->head - tail;
+  uint32_t i;
+
+  if (n > BUTTON_RING_SIZE) {
+    return 0;
+  }
+  if (n > (uint32_t)max) {
+    n = max;
+  }
+  mailbox_barrier();
+  for (i = 0; i < n; i++) {
+    events[i] = r->buf[(tail + i) & BUTTON_RING_MASK];
+  }
+  mailbox_barrier();
+  r->tail = tail + n;
+  return n;
+}
+
+#endif /* __VEGIMETER2_BUTTON_RING_H */
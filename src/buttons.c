@@ -0,0 +1,54 @@
+/*
+ * Vegimeter 2 buttons
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "buttons.h"
+#include "pins.h"
+
+HUBDATA struct button_ring buttons;
+
+#ifndef VEGIMETER_HOST
+/* Recharges the pads and returns the touched ones. */
+static uint32_t buttons_sample() {
+  OUT_HIGH_MASK(BUTTONS_MASK);
+  DIR_OUTPUT_MASK(BUTTONS_MASK);
+  DIR_INPUT_MASK(BUTTONS_MASK);
+  waitcnt(CNT + BUTTONS_DECAY * (CLKFREQ / 1000));
+  return ~GET_INPUT_MASK(BUTTONS_MASK) & BUTTONS_MASK;
+}
+
+void buttons_runner(void* par) {
+  uint32_t held = 0, touched, changed, cnt;
+  int8_t i;
+
+  buttons_sample();
+  while (1) {
+    if (held) {
+      waitcnt(CNT + BUTTONS_HOLD_POLL * (CLKFREQ / 1000));
+      cnt = CNT;
+    } else {
+      /* The pads are all charged, the leak of an untouched pad only costs
+       * a recharge. */
+      waitpne(BUTTONS_MASK, BUTTONS_MASK);
+      cnt = CNT;
+      waitcnt(cnt + BUTTONS_DEBOUNCE * (CLKFREQ / 1000));
+    }
+    touched = buttons_sample();
+    changed = touched ^ held;
+    held = touched;
+    for (i = 0; changed; i++, changed >>= 1) {
+      if (changed & 1) {
+        button_ring_put(&buttons, i, touched & GET_MASK(i) ?
+                        BUTTON_PRESS : BUTTON_RELEASE, cnt);
+      }
+    }
+  }
+}
+#else
+/* Nobody touches the simulated unit. */
+void buttons_runner(void* par) {
+}
+#endif
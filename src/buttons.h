@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_BUTTONS_H
+#define __VEGIMETER2_BUTTONS_H
+
+#include <stdint.h>
+#include "button_ring.h"
+
+/* P0 to P7, the QuickStart touch pads. */
+#define BUTTONS_MASK 0xFF
+
+/*
+ * A pad is charged high and left floating, a finger drains it low. A
+ * touched pad reads low BUTTONS_DECAY after a recharge, an untouched one
+ * only leaks away much later.
+ */
+#define BUTTONS_DECAY 5 // Milliseconds
+/* From the first edge to the sample, contact bounce settles in between. */
+#define BUTTONS_DEBOUNCE 10 // Milliseconds
+/* Recharge period while a pad is touched, to see it released. */
+#define BUTTONS_HOLD_POLL 20 // Milliseconds
+
+/* Button events, from the buttons cog to the telemetry cog. */
+extern struct button_ring buttons;
+
+/*
+ * Buttons cog. With no pad touched it sleeps in waitpne until one of them
+ * drains, then debounces on CNT and queues the presses and releases with
+ * the CNT of the edge. Only while a pad is held does it wake up every
+ * BUTTONS_HOLD_POLL, since a pad that was let go stays drained until it is
+ * recharged.
+ */
+void buttons_runner(void* par);
+
+#endif /* __VEGIMETER2_BUTTONS_H */
@@ -15,33 +15,49 @@
  */
 
 #include "vegimeter_config.h"
+#include "button_ring.h"
 
+#include <propeller.h>
 #include <bb/os.h>
 #include <bb/os/kernel/delay.h>
 #include BBOS_DRIVER_FILE(gpio/button.h)
-#include BBOS_PROCESSOR_FILE(shmem.h)
 #include BBOS_PROCESSOR_FILE(sio.h)
 #include BBOS_PROCESSOR_FILE(pins.h)
 
 static int8_t buttons_state = 0;
+/* Buttons held at the previous run, 0 before the first one. */
+static uint8_t buttons_held = 0;
+static int8_t is_initialized = 0;
 
 void
 control_panel_runner()
 {
   int8_t i;
-  uint16_t vegimeter_buttons;
+  uint8_t held, changed;
+  uint32_t cnt;
   /* QuickStart board has P0 - P7 as buttons */
   int16_t button_mask = 0xFFUL;
 
+  if (!is_initialized) {
+    button_ring_reset(VEGIMETER_BUTTONS);
+    is_initialized = 1;
+  }
+
   /*
-   * Read, update and store pressed buttons on vegimeter device.
-   * We need just one byte from the button mask.
+   * Every press and release since the previous run is an event for the UI.
+   * The LED of a button toggles on each press.
    */
-  vegimeter_buttons = shmem_read_byte(VEGIMETER_BUTTONS_ADDR);
-  vegimeter_buttons = (int8_t)are_buttons_pressed(button_mask); /* |=?*/
-  shmem_write_byte(VEGIMETER_BUTTONS_ADDR, vegimeter_buttons);
+  cnt = CNT;
+  held = (uint8_t)are_buttons_pressed(button_mask);
+  changed = held ^ buttons_held;
+  buttons_held = held;
   for (i = 0; i < 8; i++) {
-    if (vegimeter_buttons & GET_MASK(i)) {
+    if (!(changed & GET_MASK(i))) {
+      continue;
+    }
+    button_ring_put(VEGIMETER_BUTTONS, i,
+                    held & GET_MASK(i) ? BUTTON_PRESS : BUTTON_RELEASE, cnt);
+    if (held & GET_MASK(i)) {
       buttons_state ^= GET_MASK(i);
       DIR_TO(16 + i, !!(buttons_state & GET_MASK(i)));
       OUT_TO(16 + i, !!(buttons_state & GET_MASK(i)));
@@ -14,6 +14,7 @@
  */
 
 #include <vegimeter_config.h>
+#include "serial.h"
 
 #define SOIL_MIN_TEMP 2110  /* 21.1C. Almost 70F */
 #define WATER_MAX_TEMP 4000 /* 40.0C. 104.0F */
@@ -31,13 +32,13 @@ controller_runner(int water_temperature, int soil_temperature_a,
       (soil_temperature_d <= SOIL_MIN_TEMP)) {
     *heater_on = 1;
     *pump_on = 1;
-    printf("Pump and Heater ON\n");
+    serial_puts(&serial_console, "Pump and Heater ON\n");
   }
 
   /* Turn off the heater if the water is too warm */
   if (water_temperature > WATER_MAX_TEMP) {
     *heater_on = 0;
-    printf("Heater OFF\n");
+    serial_puts(&serial_console, "Heater OFF\n");
   }
 
   /* Turn off the pump and heater if the soil is warm enough */
@@ -47,6 +48,6 @@ controller_runner(int water_temperature, int soil_temperature_a,
       (soil_temperature_d > SOIL_MIN_TEMP)) {
     *heater_on = 0;
     *pump_on = 0;
-    printf("Pump and Heater OFF\n");
+    serial_puts(&serial_console, "Pump and Heater OFF\n");
   }
 }
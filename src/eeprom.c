@@ -0,0 +1,146 @@
+/*
+ * Vegimeter 2 I2C EEPROM driver
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "eeprom.h"
+#include "pins.h"
+
+/* SDA is released to the pull-up for a one. */
+#define SDA_HIGH() DIR_INPUT(EEPROM_SDA)
+#define SDA_LOW() DIR_OUTPUT(EEPROM_SDA)
+#define SCL_HIGH() OUT_HIGH(EEPROM_SCL)
+#define SCL_LOW() OUT_LOW(EEPROM_SCL)
+
+static void i2c_start() {
+  SDA_HIGH();
+  SCL_HIGH();
+  SDA_LOW();
+  SCL_LOW();
+}
+
+static void i2c_stop() {
+  SDA_LOW();
+  SCL_HIGH();
+  SDA_HIGH();
+}
+
+/* Returns 1 if the byte was acknowledged. */
+static int i2c_write(uint8_t b) {
+  int8_t i;
+  int ack;
+
+  for (i = 0; i < 8; i++) {
+    if (b & 0x80) {
+      SDA_HIGH();
+    } else {
+      SDA_LOW();
+    }
+    SCL_HIGH();
+    SCL_LOW();
+    b <<= 1;
+  }
+  SDA_HIGH();
+  SCL_HIGH();
+  ack = !GET_INPUT(EEPROM_SDA);
+  SCL_LOW();
+  return ack;
+}
+
+static uint8_t i2c_read(int ack) {
+  uint8_t b = 0;
+  int8_t i;
+
+  SDA_HIGH();
+  for (i = 0; i < 8; i++) {
+    SCL_HIGH();
+    b = (b << 1) | GET_INPUT(EEPROM_SDA);
+    SCL_LOW();
+  }
+  if (ack) {
+    SDA_LOW();
+  }
+  SCL_HIGH();
+  SCL_LOW();
+  SDA_HIGH();
+  return b;
+}
+
+/*
+ * Addresses the chip for a write of addr. Polls for the acknowledge while a
+ * previous write cycle is still going on.
+ */
+static int eeprom_select(uint16_t addr) {
+  unsigned int start = CNT;
+  unsigned int timeout = 2 * EEPROM_WRITE_TIME_MS * (CLKFREQ / 1000);
+
+  while (1) {
+    i2c_start();
+    if (i2c_write(EEPROM_I2C_ADDR)) {
+      break;
+    }
+    i2c_stop();
+    if (CNT - start > timeout) {
+      return -1;
+    }
+  }
+  if (!i2c_write(addr >> 8) || !i2c_write(addr & 0xFF)) {
+    i2c_stop();
+    return -1;
+  }
+  return 0;
+}
+
+void eeprom_init() {
+  int8_t i;
+
+  OUT_LOW(EEPROM_SDA);
+  SDA_HIGH();
+  SCL_HIGH();
+  DIR_OUTPUT(EEPROM_SCL);
+  /* Clock out whatever a reset in the middle of a read left behind. */
+  for (i = 0; i < 9; i++) {
+    SCL_LOW();
+    SCL_HIGH();
+  }
+  i2c_start();
+  i2c_stop();
+}
+
+void eeprom_release() {
+  DIR_INPUT(EEPROM_SDA);
+  DIR_INPUT(EEPROM_SCL);
+}
+
+int eeprom_read(uint16_t addr, uint8_t* data, uint16_t size) {
+  if (eeprom_select(addr)) {
+    return -1;
+  }
+  i2c_start();
+  if (!i2c_write(EEPROM_I2C_ADDR | 1)) {
+    i2c_stop();
+    return -1;
+  }
+  while (size--) {
+    *data++ = i2c_read(size > 0);
+  }
+  i2c_stop();
+  return 0;
+}
+
+int eeprom_write_page(uint16_t addr, const uint8_t* data, uint8_t size) {
+  if (eeprom_select(addr)) {
+    return -1;
+  }
+  while (size--) {
+    if (!i2c_write(*data++)) {
+      i2c_stop();
+      return -1;
+    }
+  }
+  /* The write cycle starts with the stop condition. */
+  i2c_stop();
+  return 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_EEPROM_H
+#define __VEGIMETER2_EEPROM_H
+
+#include <stdint.h>
+
+/*
+ * 24LC512 boot EEPROM of the QuickStart, 64 KB on the I2C bus at P28/P29.
+ * The boot image only uses the lower 32 KB.
+ */
+#define EEPROM_SCL 28
+#define EEPROM_SDA 29
+#define EEPROM_I2C_ADDR 0xA0
+#define EEPROM_SIZE 0x10000
+#define EEPROM_PAGE_SIZE 128
+#define EEPROM_USER_BASE 0x8000 // Free upper half
+/* Write cycle, the chip ignores us until it is over. */
+#define EEPROM_WRITE_TIME_MS 5
+
+/*
+ * Bit-banged I2C master. SCL is driven both ways like the boot loader does,
+ * SDA is open drain. Only one cog may use the EEPROM, and not while a
+ * program is being loaded. Return 0 on success, -1 if the chip did not
+ * answer.
+ */
+void eeprom_init();
+int eeprom_read(uint16_t addr, uint8_t* data, uint16_t size);
+/* Writes within one EEPROM_PAGE_SIZE aligned page. */
+int eeprom_write_page(uint16_t addr, const uint8_t* data, uint8_t size);
+/* Lets go of the bus, so that another cog can eeprom_init() it. */
+void eeprom_release();
+
+#endif /* __VEGIMETER2_EEPROM_H */
@@ -4,298 +4,336 @@
  * Copyright (c) 2013 Sladeware LLC
  */
 
-#include <bb/os.h>
-#include <propeller.h>
-#include <stdio.h>
-#include "bb/os/drivers/onewire/onewire_bus.h"
+#include "hal.h"
+#include "actuator.h"
+#include "buttons.h"
+#include "engine.h"
+#include "frame.h"
+#include "idle.h"
+#include "model.h"
+#include "onewire_cog.h"
+#include "pid.h"
 #include "pins.h"
+#include "prof.h"
+#include "sched.h"
+#include "sensors.h"
+#include "stack.h"
+#include "stats.h"
+#include "telemetry.h"
+#include "warm.h"
+#include "xbee_rx.h"
+#include "xbee_tx.h"
 
-#define HEAT_PUMP_ACTIVATION 2100 // Centi-Celsius ;)
-#define HEATER 15
 #define HEATER_DEACTIVATION 4200 // Centi-Celsius ;)
-#define POLLING_PERIOD 60000 // Milliseconds
-#define PUMP 26
-#define STR_SIZE 64
-#define TEMP_SIZE 16
-
-/* Max values */
-#define MAX_HEATER_PERIODS 80 // One hour with 60s polling periods
-#define MAX_AIR_TEMP 5000 // Centi-Celcius ;)
-
-/* Error codes for system halt conditions */
-#define ERROR_HIGH_AIR_TEMP 3
-#define ERROR_BAD_TEMP 2
-#define ERROR_MAX_HEAT 1
-
-/* Read scratch pad. */
-#define DS18B20_READ_SCRATCHPAD 0xBE
-/* Write scratch pad. */
-#define DS18B20_WRITE_SCRATCHPAD 0x4E
-/* Start temperature conversion. */
-#define DS18B20_CONVERT_TEMPERATURE 0x44
-/* Read power status. */
-#define DS18B20_READ_POWER 0xB4
-/* Scratch pad size in bytes. */
-#define DS18B20_SCRATCHPAD_SIZE 9
-
-#define DEFAULT_TEMP_READING 54321
-#define DS18B20_1_100TH_CELCIUS(value) (100 * (value))
+#define WATER_MAX_TEMP 4000 // Centi-Celsius, the heater derates above
+
+/*
+ * Soil PI controller. The output is the heater duty cycle in permille,
+ * time-proportioned over whole polling periods, see heater_set().
+ */
+#define SOIL_KP 8 // Permille per centi-Celsius
+#define SOIL_KI 0.1 // Permille per centi-Celsius per polling period
+/* Shortest heater run: about 100 relay cycles a day at most, 30 times
+ * fewer than a pulse every polling period. */
+#define HEATER_RUN_PERIODS 3
+
+/* The pump is soft-started over PUMP_PERIOD * HEATER_DUTY_MAX / PUMP_RAMP. */
+#define PUMP_PERIOD 2000 // Milliseconds
+#define PUMP_RAMP 250 // Permille per pump period
+#define PUMP_MIN_ON 100 // Milliseconds
+#define PUMP_MIN_OFF 100 // Milliseconds
+
+/*
+ * The thermal model only drives the heater when built with VEGIMETER_MODEL.
+ * On the bench it does no better than the PI, in heater runs or in energy
+ * per degree-hour, but where pre-heating matters (the frost scenario). By
+ * default it is identified and reported, and the PI drives the heater.
+ */
+#ifdef VEGIMETER_MODEL
+#define MODEL_CONTROL 1
+#else
+#define MODEL_CONTROL 0
+#endif
+#define MODEL_HORIZON 20 // Polling periods the model looks ahead
+/*
+ * Pre-heating. If the forecast has the soil fall below the setpoint within
+ * PREHEAT_HOURS even with the heater at its rest duty, the most it can keep
+ * up for hours under MAX_HEATER_PERIODS, the heater runs at least at that
+ * duty now, up to PREHEAT_HIGH above the setpoint, to store the heat that
+ * the cold hours will take.
+ */
+#define PREHEAT_HOURS 12
+#define PREHEAT_HIGH 200 // Centi-Celsius
+#define HEATER_REST_DUTY (HEATER_DUTY_MAX * HEATER_REST_ON / POLLING_PERIOD)
+
+/*
+ * Max values. The heater on-time beyond HEATER_REST_ON per polling period
+ * adds up and drains below it, so a heater held at any high duty halts:
+ * fully on after an hour with 60s polling periods, at 95% after 67
+ * periods. heater_periods is that excess in fully-on periods.
+ */
+#define MAX_HEATER_PERIODS 60
+#define HEATER_REST_ON (POLLING_PERIOD / 2) // Milliseconds
+#define HEATER_EXCESS_PERIOD (POLLING_PERIOD - HEATER_REST_ON)
 
 HUBDATA char is_initialized = 0;
-HUBDATA char str[STR_SIZE];
-HUBDATA char temp[TEMP_SIZE];
-HUBDATA int water_temp = 0, soil_temp = 0, soil_a = 0, soil_b = 0, soil_c = 0;
-HUBDATA int soil_d = 0, water_a = 0, water_b = 0, air_temp = 0;
-HUBDATA FILE* xbee;
-HUBDATA char digit[] = "0123456789";
-HUBDATA char* p;
-HUBDATA int8_t led = 0;
+/*
+ * Latest readings by role, the hottest air probe, the soil and water sums
+ * and the water spread.
+ */
+HUBDATA int sensor_temp[NUM_SENSORS];
+HUBDATA int air_temp = 0, water_temp = 0, soil_temp = 0;
+HUBDATA int water_min = 0, water_max = 0;
+HUBDATA int8_t num_soil = 0, num_water = 0;
+HUBDATA int8_t heater = 0, pump = 0;
 HUBDATA int8_t heater_periods = 0;
+HUBDATA uint32_t heater_excess = 0; // Milliseconds
+HUBDATA int16_t heater_duty = 0; // Permille
+HUBDATA int16_t heater_credit = 0; // Permille, see heater_set()
+HUBDATA int8_t heater_run = 0; // Periods left in the current run
+HUBDATA struct actuator heater_actuator, pump_actuator;
+HUBDATA struct pid soil_pid = {
+  PID_GAIN(SOIL_KP), PID_GAIN(SOIL_KI), 0, 0, 0, 0, HEATER_DUTY_MAX
+};
+HUBDATA struct model thermal_model;
+HUBDATA int8_t preheat = 0;
 HUBDATA int8_t halt = 0;
+HUBDATA int8_t action = ACTION_NONE;
 
-extern _Driver _SimpleSerialDriver;
-extern _Driver _FileDriver;
-
-/* This is a list of all drivers we can use in the
- * program. The default _InitIO function opens stdin,
- * stdout, and stderr based on the first driver in
- * the list (the serial driver, for us)
- */
-_Driver *_driverlist[] = {
-  &_SimpleSerialDriver,
-  &_FileDriver,
-  NULL
+HUBDATA struct control_mailbox control_mailbox;
+HUBDATA struct sched engine_sched;
+HUBDATA struct sched_task engine_tasks[ENGINE_NUM_TASKS] = {
+  { engine_control, POLLING_PERIOD },
+  { engine_actuators, ACTUATOR_WINDOW_MS },
 };
+HUBDATA static struct sensors_snapshot sensors_copy;
+HUBDATA static uint32_t sensors_seq = 0;
 
-int get_temp(int16_t pin) {
-  uint8_t i;
-  uint8_t sp[DS18B20_SCRATCHPAD_SIZE];
-  int sign;
-  int temp_data;
-
-  ow_reset(pin);
-  /* Start measurements... */
-  if (ow_reset(pin)) {
-    fputs("Failed to reset 1-wire BUS before reading sensor's ROM.\r\n", xbee);
-    return DEFAULT_TEMP_READING;
-  }
-  /*
-   * Now we need to read the state from the input pin to define
-   * whether the bus is "idle".
-   */
-  if (!ow_input_pin_state(pin)) {
-    return DEFAULT_TEMP_READING;
-  }
-  ow_command(DS18B20_CONVERT_TEMPERATURE, pin);
-  if (ow_reset(pin)) {
-    fputs("Failed to reset 1-wire BUS before reading sensor's ROM.\r\n", xbee);
-    return DEFAULT_TEMP_READING;
-  }
-  ow_command(DS18B20_READ_SCRATCHPAD, pin);
-  for (i=0; i<DS18B20_SCRATCHPAD_SIZE; i++) {
-    sp[i] = ow_read_byte(pin);
-  }
-  /* Process measurements... */
-  sign = sp[1] & 0xF0 ? -1 : 1; /* sign */
-  temp_data = ((unsigned)(sp[1] & 0x07) << 8) | sp[0];
-  return DS18B20_1_100TH_CELCIUS((temp_data & 0xFFFF) * sign) >> 4;
-}
+/* The cogs of the mapping, see vegimeter2.py. */
+COG_STACKS;
+HUBDATA const struct cog_config engine_cogs[NUM_STARTED_COGS] = COG_CONFIG;
+
+/*
+ * The heater and the pump are driven by the control cog's counters, which
+ * like DIRA and OUTA are per cog, so they are only ever touched from the
+ * control cog.
+ */
 
 void pump_init() {
-  DIR_OUTPUT(PUMP);
+  actuator_init(&pump_actuator, PUMP, ACTUATOR_CTRB, PUMP_PERIOD,
+                PUMP_MIN_ON, PUMP_MIN_OFF, PUMP_RAMP);
 }
 
-unsigned int pump_on() {
-  return OUT_HIGH(PUMP);
+void pump_on() {
+  pump = 1;
+  actuator_set(&pump_actuator, ACTUATOR_DUTY_MAX);
 }
 
-unsigned int pump_off() {
-  return OUT_LOW(PUMP);
+void pump_off() {
+  pump = 0;
+  actuator_off(&pump_actuator);
 }
 
 void heater_init() {
-  DIR_OUTPUT(HEATER);
+  actuator_init(&heater_actuator, HEATER, ACTUATOR_CTRA, POLLING_PERIOD,
+                0, 0, 0);
 }
 
-unsigned int heater_on() {
-  heater_periods++;
-  return OUT_HIGH(HEATER);
+/*
+ * Heater duty cycle in permille, delivered in whole polling periods: the
+ * duty adds up in heater_credit, and once that is worth
+ * HEATER_RUN_PERIODS full periods the heater runs for them (first-order
+ * sigma-delta). The water tank smooths it out, and the relay only clicks
+ * at the ends of the runs. A duty of 0, as the water limits give, ends a
+ * run at once and drops the credit.
+ */
+void heater_set(int duty) {
+  heater_duty = duty;
+  if (duty <= 0) {
+    heater_credit = 0;
+    heater_run = 0;
+    actuator_set(&heater_actuator, 0);
+    heater = 0;
+    return;
+  }
+  heater_credit += duty;
+  if (heater_run > 0 ||
+      heater_credit >= HEATER_RUN_PERIODS * HEATER_DUTY_MAX) {
+    heater_run = heater_run > 0 ? heater_run - 1 : HEATER_RUN_PERIODS - 1;
+    heater_credit -= HEATER_DUTY_MAX;
+    actuator_set(&heater_actuator, HEATER_DUTY_MAX);
+  } else {
+    actuator_set(&heater_actuator, 0);
+  }
+  heater = heater_actuator.on_ms > 0;
 }
 
-unsigned int heater_off() {
-  heater_periods = 0;
-  return OUT_LOW(HEATER);
+void heater_off() {
+  heater = 0;
+  heater_duty = 0;
+  heater_credit = 0;
+  heater_run = 0;
+  actuator_off(&heater_actuator);
 }
 
 void validate_temp(int temp) {
   if (temp == DEFAULT_TEMP_READING) {
-    fputs("Bad temperature reading. Error. Halting.", xbee);
     halt = ERROR_BAD_TEMP;
   }
 }
 
-int get_soil_a_temp() {
-  int t = get_temp(10);
-  validate_temp(t);
-  return t;
-}
-
-int get_soil_b_temp() {
-  int t = get_temp(13);
-  validate_temp(t);
-  return t;  
-}
-
-int get_soil_c_temp() {
-  int t = get_temp(14);
-  validate_temp(t);
-  return t;
-}
-
-int get_soil_d_temp() {
-  int t = get_temp(12);
-  validate_temp(t);
-  return t;
-}
-
-int get_water_a_temp() {
-  int t = get_temp(11);
-  validate_temp(t);
-  return t;
-}
-
-int get_water_b_temp() {
-  int t = get_temp(9);
-  validate_temp(t);
-  return t;
-}
-
-int get_air_temp() {
-  int t = get_temp(8);
-  validate_temp(t);
-  return t;
-}
-
-void engine_wait_ms(unsigned int ms) {
-  unsigned waitcycles;
-  unsigned millisecond = _clkfreq / 1000;
-
-  waitcycles = CNT;
-  while (ms > 0) {
-    waitcycles += millisecond;
-    __napuntil(waitcycles);
-    --ms;
-  }
-}
-
-void led_init() {
-  DIR_OUTPUT(23);
-  DIR_OUTPUT(22);
-  DIR_OUTPUT(21);
-  DIR_OUTPUT(20);
-  DIR_OUTPUT(19);
-  DIR_OUTPUT(18);
-  DIR_OUTPUT(17);
-  DIR_OUTPUT(16);
-}
-
-void led_on(int pin) {
-  OUT_HIGH(pin);
-  led = 1;
+/*
+ * Actuators task: re-arms the counters when due and sleeps until the next
+ * re-arm. The control task wakes it up whenever it changed them.
+ */
+unsigned int engine_actuators() {
+  unsigned int heater_ms, pump_ms, ms;
+
+  PROF_BEGIN(PROF_ACTUATORS);
+  heater_ms = actuator_poll(&heater_actuator);
+  pump_ms = actuator_poll(&pump_actuator);
+  ms = heater_ms < pump_ms ? heater_ms : pump_ms;
+  PROF_END(PROF_ACTUATORS);
+  return ms == ACTUATOR_IDLE ? 0 : ms;
 }
 
-void led_off(int pin) {
-  OUT_LOW(pin);
-  led = 0;
+void engine_publish() {
+  struct control_snapshot* c = &control_mailbox.data;
+
+  mailbox_write_begin(&control_mailbox);
+  memcpy(c->temp, sensor_temp, sizeof(sensor_temp));
+  c->soil_temp = soil_temp;
+  c->water_temp = water_temp;
+  c->heater = heater;
+  c->pump = pump;
+  c->action = action;
+  c->heater_duty = heater_duty;
+  c->heater_credit = heater_credit;
+  c->heater_run = heater_run;
+  c->heater_periods = heater_periods;
+  c->heater_excess = heater_excess;
+  c->halt = halt;
+  c->pid_integral = soil_pid.integral;
+  c->pid_prev_error = soil_pid.prev_error;
+  memcpy(c->soil_model, thermal_model.soil.theta, sizeof(c->soil_model));
+  memcpy(c->water_model, thermal_model.water.theta, sizeof(c->water_model));
+  c->model_samples = thermal_model.soil.n;
+  c->model_valid = model_valid(&thermal_model);
+  mailbox_write_end(&control_mailbox);
 }
 
-void error_leds() {
-  int i;
+/*
+ * Warm restart, puts back the state of the snapshot before the other cogs
+ * start. The pump, and the heater in the middle of a run, are running
+ * again before the first sample, and the first control step carries on
+ * with the run, the PI state, the heater excess and the thermal model.
+ * Only the halts that the sensors cannot show again are kept.
+ */
+void engine_warm(struct warm_state* w) {
+  int8_t role;
 
-  for (i = 16; i <= 23; i++) {
-    led_on(i);
+  for (role = 0; role < NUM_SENSORS; role++) {
+    sensor_temp[role] = w->temp[role] == FRAME_NO_READING ?
+      DEFAULT_TEMP_READING : w->temp[role];
   }
-}
-
-void strobe_leds() {
-  int wait = 200;
-  int i;
-
-  for (i = 16; i <= 23; i++) {
-    led_on(i);
-    engine_wait_ms(wait);
-    led_off(i);
+  heater_excess = w->heater_excess;
+  heater_periods = heater_excess / HEATER_EXCESS_PERIOD;
+  soil_pid.integral = w->pid_integral;
+  soil_pid.prev_error = w->pid_prev_error;
+  if (w->model) {
+    model_warm(&thermal_model, w->soil_model, w->water_model);
   }
-}
-
-void blink_led() {
-  int pin = 20;
-
-  led_on(pin);
-  engine_wait_ms(500);
-  led_off(pin);  
-}
-
-void engine_xbee_init() {
-  xbee = fopen("SSER:9600,24,25", "w"); // p24 out, p25 in
-  if (xbee == NULL) {
-    puts("ERROR: Cannot open the XBee");
+  if (w->halt == ERROR_MAX_HEAT || w->halt == ERROR_HIGH_AIR_TEMP) {
+    halt = w->halt;
+    action = ACTION_HALTED;
     return;
   }
-  setbuf(xbee, 0);
-  fputs("XBee initialized.\n", xbee);
+  if (w->halt == 0) {
+    action = w->action;
+  }
+  heater_duty = w->heater_duty;
+  heater_credit = w->heater_credit;
+  heater_run = w->heater_run;
+  if (w->heater) {
+    actuator_set(&heater_actuator, HEATER_DUTY_MAX);
+    heater = 1;
+  }
+  if (w->pump) {
+    pump_on();
+  }
 }
 
 void engine_init() {
+  struct warm_state w;
+  int8_t i;
+
   if (is_initialized != 1) {
     is_initialized = 1;
 
-    led_init();
     pump_init();
     heater_init();
-    engine_xbee_init();
 
     heater_off();
     pump_off();
+    model_init(&thermal_model);
+    eeprom_init();
+    if (warm_restore(&w) == 0) {
+      engine_warm(&w);
+    }
+    eeprom_release();
+    sched_init(&engine_sched, engine_tasks, ENGINE_NUM_TASKS, IDLE_ENGINE);
 
-    fputs("Engine initialized.\n", xbee);
+    for (i = 0; i < NUM_STARTED_COGS; i++) {
+      stack_paint(engine_cogs[i].stack, engine_cogs[i].size);
+      cogstart(engine_cogs[i].runner, NULL, engine_cogs[i].stack,
+               engine_cogs[i].size);
+    }
   }
 }
 
-void itoa(int i, char b[]) {
-  p = b;
-  memset(b, 0, TEMP_SIZE);
+/*
+ * Takes the latest sensors snapshot. The sensing cog publishes several
+ * times per polling period, so a snapshot that did not change since the
+ * last period means that the sensing cog is stuck.
+ */
+void engine_read_sensors() {
+  uint32_t seq = mailbox_read(&sensors_mailbox, &sensors_copy);
+  int8_t role;
+  int t;
 
-  if (i < 0) {
-    *p++ = '-';
-    i *= -1;
+  if (seq == sensors_seq) {
+    halt = ERROR_STALE_SENSORS;
+    return;
   }
-
-  int shifter = i, ctr=TEMP_SIZE;
-  do {
-    ++p;
-    shifter /= 10;
-  } while (shifter && --ctr > 0);
-  *p = '\0';
-
-  ctr = TEMP_SIZE;
-  do {
-    *--p = digit[i % 10];
-    i /= 10;
-  } while (i && --ctr > 0);
-}
-
-void engine_runnerT() {
-  int i = -13;
-
-  while (1) {
-    i++;
-    engine_init();
-    blink_led();
-    itoa(i, temp);
-    fputs(temp, xbee);
-    fputs("\n", xbee);
-    engine_wait_ms(500);
+  sensors_seq = seq;
+
+  air_temp = DS18B20_1_100TH_CELCIUS(DS18B20_RAW_MIN / 16);
+  soil_temp = water_temp = 0;
+  num_soil = num_water = 0;
+  for (role = 0; role < NUM_SENSORS; role++) {
+    t = sensor_temp[role] = sensors_copy.temp[role];
+    validate_temp(t);
+    switch (sensor_config[role].kind) {
+    case SENSOR_KIND_AIR:
+      if (t > air_temp) {
+        air_temp = t;
+      }
+      break;
+    case SENSOR_KIND_SOIL:
+      soil_temp += t;
+      num_soil++;
+      break;
+    case SENSOR_KIND_WATER:
+      if (num_water == 0 || t < water_min) {
+        water_min = t;
+      }
+      if (num_water == 0 || t > water_max) {
+        water_max = t;
+      }
+      water_temp += t;
+      num_water++;
+      break;
+    }
   }
 }
 
@@ -303,16 +341,12 @@ int halt_on_error() {
   if (halt > 0) {
     heater_off();
     pump_off();
+    heater_periods = 0;
+    heater_excess = 0;
+    pid_reset(&soil_pid);
 
-    strcpy(str, "System error. Halted. Code: ");
-    itoa(halt, temp);
-    strcat(str, temp);
-    strcat(str, "\n");
-    fputs(str, xbee);      
-    memset(str, 0, STR_SIZE);
-
-    error_leds();
-    engine_wait_ms(POLLING_PERIOD);
+    action = ACTION_HALTED;
+    engine_publish();
 
     return 1;
   } else {
@@ -320,100 +354,168 @@ int halt_on_error() {
   }
 }
 
-void engine_runner() {
-  while (1) {
-    if (halt_on_error()) {
-      continue;
-    }
+/*
+ * Soil temperature for the controller: the mean of the soil probes over the
+ * short statistics window, which averages out the conversion noise. Falls
+ * back on the latest readings until every probe has samples.
+ */
+int engine_soil_mean() {
+  struct stats_summary s;
+  int8_t role;
+  int sum = 0;
 
-    engine_init();
-
-    blink_led();
-
-    strcpy(str, "A: ");
-    air_temp = get_air_temp();
-    itoa(air_temp, temp);
-    strcat(str, temp);
-    strcat(str, "\n");
-    fputs(str, xbee);
-    memset(str, 0, STR_SIZE);
-    if (air_temp >= MAX_AIR_TEMP) {
-      fputs("Max air temperature reached. Error. Halting.\n", xbee);
-      halt = ERROR_HIGH_AIR_TEMP;
-      heater_off();
-      pump_off();
+  for (role = 0; role < NUM_SENSORS; role++) {
+    if (sensor_config[role].kind != SENSOR_KIND_SOIL) {
       continue;
     }
-
-    soil_a = get_soil_a_temp();
-    soil_b = get_soil_b_temp();
-    soil_c = get_soil_c_temp();
-    soil_d = get_soil_d_temp();
-    soil_temp = soil_a + soil_b + soil_c + soil_d;
-
-    strcpy(str, "S: ");
-    itoa(soil_a, temp);
-    strcat(str, temp);
-    strcat(str, ",");
-    itoa(soil_b, temp);
-    strcat(str, temp);
-    strcat(str, ",");
-    itoa(soil_c, temp);
-    strcat(str, temp);
-    strcat(str, ",");
-    itoa(soil_d, temp);
-    strcat(str, temp);
-    strcat(str, "\n");
-    fputs(str, xbee);
-    memset(str, 0, STR_SIZE);
-
-    water_a = get_water_a_temp();
-    water_b = get_water_b_temp();
-    water_temp = water_a + water_b;
-
-    strcpy(str, "W: ");
-    itoa(water_a, temp);
-    strcat(str, temp);
-    strcat(str, ",");
-    itoa(water_b, temp);
-    strcat(str, temp);
-    strcat(str, "\n");
-    fputs(str, xbee);
-    memset(str, 0, STR_SIZE);
-
-    if (soil_temp < HEAT_PUMP_ACTIVATION * 4) {
-      if (water_temp > HEATER_DEACTIVATION * 2 ||
-	  water_a >> 1 > water_b ||
-	  water_b >> 1 > water_a) {
-	heater_off();
-	fputs("Heat off.\n", xbee);
-      } else {
-	heater_on();
-	strcpy(str, "Heater On: ");
-	itoa(heater_periods, temp);
-	strcat(str, temp);
-	strcat(str, "\n");
-	fputs(str, xbee);
-	memset(str, 0, STR_SIZE);
-      }
-      pump_on();
-      fputs("Pump on.\n", xbee);
-    } else {
-      fputs("Heat pump deactivated\n", xbee);
-      heater_off();
-      pump_off();
+    stats_summary(role, STATS_WINDOW_SHORT, &s);
+    if (s.n == 0) {
+      return soil_temp / num_soil;
     }
+    sum += s.mean;
+  }
+  return sum / num_soil;
+}
 
-    if (heater_periods > MAX_HEATER_PERIODS) {
-      fputs("Max heater periods reached. Error. Halting.\n", xbee);
-      halt = ERROR_MAX_HEAT;
-      heater_off();
-      pump_off();
-      continue;
+/*
+ * Most heater duty the water allows: all of it up to WATER_MAX_TEMP, derated
+ * linearly from there down to nothing at HEATER_DEACTIVATION. Water probes
+ * that disagree by more than 2x keep the heater off.
+ */
+int engine_heater_max(int water) {
+  if (water >= HEATER_DEACTIVATION ||
+      water_max >> 1 > water_min ||
+      water_min >> 1 > water_max) {
+    return 0;
+  }
+  if (water > WATER_MAX_TEMP) {
+    return HEATER_DUTY_MAX * (HEATER_DEACTIVATION - water) /
+      (HEATER_DEACTIVATION - WATER_MAX_TEMP);
+  }
+  return HEATER_DUTY_MAX;
+}
+
+/*
+ * Heater duty cycle for this polling period, up to what the water allows:
+ * with MODEL_CONTROL and a valid thermal model, the one that gets the soil
+ * to the setpoint in MODEL_HORIZON periods, or more to pre-heat, the soil
+ * PI output otherwise. The PI gets the water limit as its out_max, so its
+ * integral does not wind up while the water holds the heater back.
+ */
+int engine_heater_duty(int soil) {
+  int water = water_temp / num_water;
+  int max = engine_heater_max(water);
+  int duty;
+
+  if (MODEL_CONTROL && model_valid(&thermal_model)) {
+    /* The forecast runs the model for hours, once per model sample. */
+    if (thermal_model.periods == 1) {
+      preheat = model_lowest(&thermal_model, air_temp, soil, water,
+                             HEATER_REST_DUTY, WATER_MAX_TEMP,
+                             PREHEAT_HOURS) < SOIL_SETPOINT;
     }
+    duty = model_duty(&thermal_model, air_temp, soil, water, SOIL_SETPOINT,
+                      MODEL_HORIZON);
+    if (preheat && soil < SOIL_SETPOINT + PREHEAT_HIGH &&
+        duty < HEATER_REST_DUTY) {
+      duty = HEATER_REST_DUTY;
+    }
+    if (duty > max) {
+      duty = max;
+    }
+    /* The PI takes over from there if the model is lost. */
+    soil_pid.integral = (int32_t)duty << PID_Q;
+    soil_pid.prev_error = SOIL_SETPOINT - soil;
+  } else {
+    soil_pid.out_max = max;
+    duty = pid_update(&soil_pid, SOIL_SETPOINT - soil);
+  }
+  return duty;
+}
 
-    strobe_leds();
-    
-    engine_wait_ms(POLLING_PERIOD);
+/*
+ * Control task, one polling period of the control loop. The first one
+ * waits for the first sensors snapshot.
+ */
+unsigned int engine_step() {
+  int soil, mean;
+
+  if (sensors_mailbox.seq < 2) {
+    return ENGINE_FIRST_SAMPLE_POLL;
   }
+  if (halt_on_error()) {
+    return 0;
+  }
+
+  action = ACTION_NONE;
+  engine_read_sensors();
+  if (halt) {
+    heater_off();
+    pump_off();
+    engine_publish();
+    return 0;
+  }
+
+  if (air_temp >= MAX_AIR_TEMP) {
+    halt = ERROR_HIGH_AIR_TEMP;
+    heater_off();
+    pump_off();
+    engine_publish();
+    return 0;
+  }
+
+  mean = engine_soil_mean();
+  heater_set(engine_heater_duty(mean));
+  /* Heater on-time over the rest allowance, see MAX_HEATER_PERIODS. */
+  heater_excess += heater_actuator.on_ms;
+  heater_excess = heater_excess > HEATER_REST_ON ?
+    heater_excess - HEATER_REST_ON : 0;
+  heater_periods = heater_excess / HEATER_EXCESS_PERIOD;
+
+  /* The pump and the action go by what the heater does, the duty only adds
+   * up to runs. Between runs the pump moves the heat left in the water
+   * while the soil asks for it. */
+  soil = soil_temp / num_soil;
+  if (heater ||
+      ((heater_duty > 0 || soil < SOIL_SETPOINT) &&
+       water_temp / num_water > soil + PUMP_MIN_GAIN)) {
+    pump_on();
+    action = heater ? ACTION_HEATER_ON : ACTION_HEATER_OFF;
+  } else {
+    pump_off();
+    action = ACTION_HEAT_PUMP_OFF;
+  }
+
+  if (heater_periods > MAX_HEATER_PERIODS) {
+    halt = ERROR_MAX_HEAT;
+    heater_off();
+    pump_off();
+  }
+  model_step(&thermal_model, air_temp, mean, water_temp / num_water,
+             heater_actuator.on_ms / (POLLING_PERIOD / HEATER_DUTY_MAX),
+             pump);
+
+  sched_wake(&engine_sched, &engine_tasks[ENGINE_TASK_ACTUATORS]);
+  engine_publish();
+  return 0;
+}
+
+/* Control task, engine_step() timed as PROF_CONTROL. */
+unsigned int engine_control() {
+  unsigned int ms;
+
+  PROF_BEGIN(PROF_CONTROL);
+  ms = engine_step();
+  PROF_END(PROF_CONTROL);
+  return ms;
+}
+
+/*
+ * Control cog, runs the control and the actuators tasks. It only reads the
+ * latest published sensors snapshot and publishes its decisions, so it
+ * never waits on the 1-Wire buses or the XBee.
+ */
+void engine_runner() {
+  engine_init();
+  sched_run(&engine_sched);
 }
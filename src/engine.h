@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_ENGINE_H
+#define __VEGIMETER2_ENGINE_H
+
+#include <stdint.h>
+#include "actuator.h"
+#include "mailbox.h"
+#include "model.h"
+#include "sched.h"
+#include "sensors.h"
+
+#define POLLING_PERIOD 60000 // Milliseconds
+#define ENGINE_FIRST_SAMPLE_POLL 100 // Milliseconds
+
+/* Control cog tasks, see sched.h. */
+#define ENGINE_TASK_CONTROL 0
+#define ENGINE_TASK_ACTUATORS 1
+#define ENGINE_NUM_TASKS 2
+
+/* Control thresholds, the sensing cog sizes its resolution on them. */
+#define SOIL_SETPOINT 2100 // Centi-Celsius ;)
+#define PUMP_MIN_GAIN 200 // Centi-Celsius water above soil worth pumping
+#define MAX_AIR_TEMP 5000 // Centi-Celcius ;)
+
+/* Heater duty cycle full scale, permille. */
+#define HEATER_DUTY_MAX ACTUATOR_DUTY_MAX
+
+/* Actuator pins */
+#define HEATER 15
+#define PUMP 26
+
+/* Error codes for system halt conditions */
+#define ERROR_STALE_SENSORS 4
+#define ERROR_HIGH_AIR_TEMP 3
+#define ERROR_BAD_TEMP 2
+#define ERROR_MAX_HEAT 1
+
+/* Control actions taken in the last polling period */
+#define ACTION_NONE 0
+#define ACTION_HALTED 1
+#define ACTION_HEAT_PUMP_OFF 2
+#define ACTION_HEATER_OFF 3 /* Pump on, water is too warm */
+#define ACTION_HEATER_ON 4 /* Pump on */
+
+/*
+ * The control loop runs in the ENGINE thread, sensing, telemetry, the
+ * 1-Wire coprocessor, the XBee transmitter and receiver and the buttons get
+ * a cog each.
+ * The cogs and their stack sizes are declared in the mapping, see
+ * vegimeter2.py.
+ */
+struct cog_config {
+  void (*runner)(void* par);
+  int* stack;
+  unsigned int size; /* Bytes */
+};
+
+/* Published by the control cog once per polling period. */
+struct control_snapshot {
+  int temp[NUM_SENSORS];
+  int soil_temp;
+  int water_temp;
+  int8_t heater;
+  int8_t pump;
+  int8_t action;
+  int16_t heater_duty; /* Permille */
+  int16_t heater_credit; /* Permille, the run credit */
+  int8_t heater_run; /* Periods left in the run */
+  int8_t heater_periods;
+  uint32_t heater_excess; /* Milliseconds, see MAX_HEATER_PERIODS */
+  int8_t halt;
+  int32_t pid_integral; /* Q8 */
+  int pid_prev_error;
+  int32_t soil_model[RLS_N]; /* Q24, see model.h */
+  int32_t water_model[RLS_N];
+  uint16_t model_samples;
+  int8_t model_valid;
+};
+
+struct control_mailbox {
+  volatile uint32_t seq;
+  struct control_snapshot data;
+};
+
+extern struct control_mailbox control_mailbox;
+extern struct sched engine_sched;
+/* The cogs the engine starts, their stacks are painted first. */
+extern const struct cog_config engine_cogs[NUM_STARTED_COGS];
+
+unsigned int engine_actuators();
+void engine_init();
+unsigned int engine_step();
+unsigned int engine_control();
+void engine_runner();
+
+#endif /* __VEGIMETER2_ENGINE_H */
@@ -0,0 +1,65 @@
+/*
+ * Vegimeter 2 formatting
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "fmt.h"
+
+char* fmt_str(char* p, const char* s) {
+  while (*s) {
+    *p++ = *s++;
+  }
+  *p = '\0';
+  return p;
+}
+
+char* fmt_uint(char* p, uint32_t v) {
+  char digits[FMT_INT_SIZE];
+  int8_t n = 0;
+
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n) {
+    *p++ = digits[--n];
+  }
+  *p = '\0';
+  return p;
+}
+
+char* fmt_int(char* p, int32_t v) {
+  if (v < 0) {
+    *p++ = '-';
+    /* -INT32_MIN does not fit, its unsigned negation does. */
+    return fmt_uint(p, -(uint32_t)v);
+  }
+  return fmt_uint(p, v);
+}
+
+char* fmt_hex(char* p, uint32_t v, int8_t digits) {
+  int8_t i;
+
+  for (i = digits - 1; i >= 0; i--) {
+    p[i] = "0123456789ABCDEF"[v & 0xF];
+    v >>= 4;
+  }
+  p += digits;
+  *p = '\0';
+  return p;
+}
+
+char* fmt_centi(char* p, int32_t v) {
+  uint32_t u = v < 0 ? -(uint32_t)v : (uint32_t)v;
+
+  if (v < 0) {
+    *p++ = '-';
+  }
+  p = fmt_uint(p, u / 100);
+  *p++ = '.';
+  *p++ = '0' + u % 100 / 10;
+  *p++ = '0' + u % 10;
+  *p = '\0';
+  return p;
+}
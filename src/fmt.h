@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_FMT_H
+#define __VEGIMETER2_FMT_H
+
+#include <stdint.h>
+
+/*
+ * Formatting without printf. Each function appends to the caller's buffer
+ * at p, ends it with a NUL and returns the NUL, so calls chain:
+ *
+ *   p = fmt_str(line, "soil ");
+ *   p = fmt_centi(p, temp);
+ *   serial_write(&serial_console, line, p - line);
+ *
+ * The caller makes the room, at most FMT_INT_SIZE bytes for a number.
+ */
+#define FMT_INT_SIZE 12 /* "-2147483648" and the NUL */
+
+char* fmt_str(char* p, const char* s);
+char* fmt_uint(char* p, uint32_t v);
+char* fmt_int(char* p, int32_t v);
+/* Exactly digits hex digits, the high ones are dropped. */
+char* fmt_hex(char* p, uint32_t v, int8_t digits);
+/* Centi-Celsius as degrees with two decimals, 2110 is "21.10". */
+char* fmt_centi(char* p, int32_t v);
+
+#endif /* __VEGIMETER2_FMT_H */
@@ -0,0 +1,131 @@
+/*
+ * Vegimeter 2 binary telemetry frames
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "frame.h"
+#include "sensors.h"
+#include "xbee_tx.h"
+
+/* CRC-16/CCITT, a nibble at a time. */
+HUBDATA static const uint16_t crc16_nibble[16] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+HUBDATA static uint16_t frame_crc;
+HUBDATA static uint16_t frame_seq = 0;
+
+uint16_t crc16_update(uint16_t crc, uint8_t b) {
+  crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (b >> 4)];
+  crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (b & 0x0F)];
+  return crc;
+}
+
+void frame_put_u8(uint8_t v) {
+  frame_crc = crc16_update(frame_crc, v);
+  xbee_put(v);
+}
+
+void frame_put_u16(uint16_t v) {
+  frame_put_u8(v & 0xFF);
+  frame_put_u8(v >> 8);
+}
+
+void frame_put_u32(uint32_t v) {
+  frame_put_u16(v & 0xFFFF);
+  frame_put_u16(v >> 16);
+}
+
+void frame_put(const uint8_t* data, uint8_t size) {
+  while (size--) {
+    frame_put_u8(*data++);
+  }
+}
+
+void frame_put_temp(int temp) {
+  if (temp == DEFAULT_TEMP_READING || temp < -32767 || temp > 32767) {
+    temp = FRAME_NO_READING;
+  }
+  frame_put_u16((uint16_t)temp);
+}
+
+void frame_begin(uint8_t type, uint8_t length) {
+  xbee_reserve(FRAME_SIZE(length));
+  xbee_put(FRAME_SYNC0);
+  xbee_put(FRAME_SYNC1);
+  frame_crc = 0xFFFF;
+  frame_put_u8(FRAME_VERSION);
+  frame_put_u8(type);
+  frame_put_u8(length);
+  frame_put_u16(frame_seq++);
+}
+
+void frame_end() {
+  uint16_t crc = frame_crc;
+
+  xbee_put(crc & 0xFF);
+  xbee_put(crc >> 8);
+  xbee_commit();
+}
+
+void frame_parser_init(struct frame_parser* p) {
+  p->pos = 0;
+}
+
+uint8_t frame_parse(struct frame_parser* p, uint8_t b) {
+  uint8_t end;
+
+  switch (p->pos) {
+  case 0:
+    p->pos = b == FRAME_SYNC0;
+    return 0;
+  case 1:
+    if (b == FRAME_SYNC1) {
+      p->pos = 2;
+      p->crc = 0xFFFF;
+      p->length = 0;
+    } else {
+      p->pos = b == FRAME_SYNC0;
+    }
+    return 0;
+  case 2:
+    if (b != FRAME_VERSION) {
+      p->pos = 0;
+      return 0;
+    }
+    break;
+  case 3:
+    p->type = b;
+    break;
+  case 4:
+    if (b > FRAME_CMD_MAX_SIZE) {
+      p->pos = 0;
+      return 0;
+    }
+    p->length = b;
+    break;
+  }
+
+  end = FRAME_HEADER_SIZE + p->length;
+  if (p->pos < end) {
+    if (p->pos >= FRAME_HEADER_SIZE) {
+      p->payload[p->pos - FRAME_HEADER_SIZE] = b;
+    }
+    p->crc = crc16_update(p->crc, b);
+    p->pos++;
+    return 0;
+  }
+  if (p->pos == end) {
+    if (b != (p->crc & 0xFF)) {
+      p->pos = 0;
+      return 0;
+    }
+    p->pos++;
+    return 0;
+  }
+  p->pos = 0;
+  return b == (p->crc >> 8) ? p->type : 0;
+}
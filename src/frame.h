@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_FRAME_H
+#define __VEGIMETER2_FRAME_H
+
+#include <stdint.h>
+#include "eeprom.h"
+#include "idle.h"
+#include "model.h"
+#include "prof.h"
+#include "sensors.h"
+
+/*
+ * Binary telemetry frames. All fields are little endian.
+ *
+ *   0  sync      0xA5 0x5A
+ *   2  version   FRAME_VERSION
+ *   3  type      FRAME_STATUS, FRAME_BOOT, ...
+ *   4  length    payload size in bytes
+ *   5  seq       uint16, incremented for every frame
+ *   7  payload   length bytes
+ *   .  crc       uint16, CRC-16/CCITT (0x1021, init 0xFFFF) over version
+ *                through the end of the payload
+ *
+ * Temperatures are int16 centi-Celsius, FRAME_NO_READING stands for a bad
+ * reading. tools/vegimeter_frame.py decodes the frames on the host and has
+ * to be kept in sync with this file.
+ */
+
+#define FRAME_SYNC0 0xA5
+#define FRAME_SYNC1 0x5A
+#define FRAME_VERSION 12
+#define FRAME_HEADER_SIZE 7
+#define FRAME_CRC_SIZE 2
+#define FRAME_SIZE(length) (FRAME_HEADER_SIZE + (length) + FRAME_CRC_SIZE)
+
+#define FRAME_NO_READING (-32768)
+
+/*
+ * FRAME_STATUS, once per control snapshot:
+ *   int16 temp[NUM_SENSORS] by role, uint8 actuators (bit 0 heater,
+ *   bit 1 pump), uint8 action, uint16 heater duty (permille),
+ *   uint8 heater_periods (excess heater on-time in fully-on periods, see
+ *   MAX_HEATER_PERIODS), uint8 halt, uint16 XBee bytes dropped (saturated)
+ */
+#define FRAME_STATUS 1
+#define FRAME_STATUS_SIZE (2 * NUM_SENSORS + 8)
+#define FRAME_ACTUATOR_HEATER 0x01
+#define FRAME_ACTUATOR_PUMP 0x02
+/*
+ * FRAME_BOOT, once the sensing cog is up:
+ *   uint8 DS18B20 found, uint8 sensors in the table
+ */
+#define FRAME_BOOT 2
+#define FRAME_BOOT_SIZE 2
+/*
+ * FRAME_IDLE, after every FRAME_STATUS, for each cog in idle.h order:
+ *   uint32 microseconds awake, uint32 microseconds asleep, uint16 naps
+ *   (saturated), all since the previous FRAME_IDLE
+ */
+#define FRAME_IDLE 3
+#define FRAME_IDLE_SIZE (10 * IDLE_NUM_COGS)
+/*
+ * FRAME_SCHED, after every FRAME_IDLE, for each scheduler task (engine
+ * control and actuators, sensors convert and read, telemetry report, LEDs,
+ * host and buttons):
+ *   uint32 worst start lateness in microseconds, uint16 overruns, both
+ *   since boot
+ */
+#define FRAME_SCHED 4
+#define FRAME_SCHED_TASK_SIZE 6
+/*
+ * FRAME_STATS, every TELEMETRY_STATS_REPORTS status frames:
+ *   uint8 window size in samples, then for each role: int16 mean, int16
+ *   min, int16 max, uint16 standard deviation, int16 slope (centi-Celsius
+ *   per hour), uint8 samples in the window (0: no statistics yet)
+ */
+#define FRAME_STATS 5
+#define FRAME_STATS_SIZE (1 + 11 * NUM_SENSORS)
+/*
+ * FRAME_HISTORY, in answer to FRAME_CMD_HISTORY_DUMP, one per page of the
+ * history log (see history.h):
+ *   uint16 frame index in the dump, uint8 flags (FRAME_HISTORY_LAST on the
+ *   last frame), then the page
+ */
+#define FRAME_HISTORY 6
+#define FRAME_HISTORY_SIZE (3 + EEPROM_PAGE_SIZE)
+#define FRAME_HISTORY_LAST 0x01
+/*
+ * FRAME_SENSOR_ERRORS, with every FRAME_STATS, for each role:
+ *   uint16 full scratch pad reads that failed, uint16 samples lost after
+ *   the retries, both since boot and saturated
+ */
+#define FRAME_SENSOR_ERRORS 7
+#define FRAME_SENSOR_ERRORS_SIZE (4 * NUM_SENSORS)
+/*
+ * FRAME_BUTTONS, as soon as the telemetry cog sees button events:
+ *   uint8 events, uint16 events dropped since boot (saturated), then for
+ *   each event: uint8 button (bit 7 set on a press, clear on a release),
+ *   uint32 CNT of the edge
+ */
+#define FRAME_BUTTONS 8
+#define FRAME_BUTTONS_MAX 8 /* Events per frame */
+#define FRAME_BUTTONS_SIZE(n) (3 + 5 * (n))
+#define FRAME_BUTTON_PRESS 0x80
+
+/*
+ * FRAME_MEMORY, with the statistics summary:
+ *   uint8 cogs, then for each cog started by the engine, in the order of
+ *   the mapping: uint16 stack bytes, uint16 stack bytes ever used (see
+ *   stack.h)
+ */
+#define FRAME_MEMORY 9
+#define FRAME_MEMORY_SIZE (1 + 4 * NUM_STARTED_COGS)
+
+/*
+ * FRAME_PROFILE, between two statistics summaries when built with
+ * VEGIMETER_PROFILE (see prof.h):
+ *   uint8 phases, uint8 cycles per microsecond, then for each phase:
+ *   uint32 longest run in cycles since boot, then for each log2 bucket
+ *   uint16 runs since the previous FRAME_PROFILE (saturated)
+ */
+#define FRAME_PROFILE 10
+#define FRAME_PROFILE_SIZE (2 + (4 + 2 * PROF_BUCKETS) * PROF_NUM_PHASES)
+
+/*
+ * FRAME_MODEL, with the statistics summary, the thermal model (model.h):
+ *   uint8 flags, uint16 samples, int32 a, b, c, d, e and f in Q24, per
+ *   polling period
+ */
+#define FRAME_MODEL 11
+#define FRAME_MODEL_SIZE (3 + 8 * RLS_N)
+#define FRAME_MODEL_VALID 0x01 /* The controller uses it */
+
+/*
+ * Commands, frames from the host to the device. Same layout, the type has
+ * the top bit set.
+ *
+ * FRAME_CMD_HISTORY_DUMP, no payload: dump the history log.
+ * FRAME_CMD_COLD_START, no payload: erase the warm restart snapshots, the
+ * next boot is cold.
+ */
+#define FRAME_CMD_HISTORY_DUMP 0x81
+#define FRAME_CMD_COLD_START 0x82
+/* Longest command payload. */
+#define FRAME_CMD_MAX_SIZE 8
+
+uint16_t crc16_update(uint16_t crc, uint8_t b);
+
+/*
+ * Frames are encoded in a single pass straight into the XBee transmit
+ * buffer: frame_begin() reserves the room and writes the header, the
+ * frame_put_*() calls append the payload while updating the CRC and
+ * frame_end() appends the CRC and commits the frame. Only the telemetry
+ * cog encodes frames.
+ */
+void frame_begin(uint8_t type, uint8_t length);
+void frame_put_u8(uint8_t v);
+void frame_put_u16(uint16_t v);
+void frame_put_u32(uint32_t v);
+void frame_put_temp(int temp);
+void frame_end();
+void frame_put(const uint8_t* data, uint8_t size);
+
+/*
+ * Incremental command decoder. frame_parse() is fed the received bytes
+ * one by one and returns the type of a command once its last byte passed
+ * the CRC check, 0 otherwise. Anything else is skipped while looking for
+ * the next sync marker.
+ */
+struct frame_parser {
+  uint8_t pos; /* Of the next byte in the frame */
+  uint8_t type;
+  uint8_t length;
+  uint16_t crc;
+  uint8_t payload[FRAME_CMD_MAX_SIZE];
+};
+
+void frame_parser_init(struct frame_parser* p);
+uint8_t frame_parse(struct frame_parser* p, uint8_t b);
+
+#endif /* __VEGIMETER2_FRAME_H */
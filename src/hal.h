@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_HAL_H
+#define __VEGIMETER2_HAL_H
+
+/*
+ * Hardware abstraction for the engine. On the Propeller it is just the
+ * BBOS, propgcc and onewire_bus headers. With VEGIMETER_HOST the same
+ * names are backed by the thermal plant simulator in sim/, so the engine
+ * sources build and run unchanged on Linux.
+ */
+
+#ifndef VEGIMETER_HOST
+
+#include <bb/os.h>
+#include <propeller.h>
+#include "bb/os/drivers/onewire/onewire_bus.h"
+
+/* Sets up counter A (0) or B (1) of the calling cog. */
+static inline void hal_ctr_write(int ctr, uint32_t mode, uint32_t frq,
+                                 uint32_t phs) {
+  if (ctr) {
+    FRQB = frq;
+    PHSB = phs;
+    CTRB = mode;
+  } else {
+    FRQA = frq;
+    PHSA = phs;
+    CTRA = mode;
+  }
+}
+
+#else /* VEGIMETER_HOST */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HUBDATA
+
+/* Registers. There is one set for all the simulated cogs. */
+extern volatile uint32_t hal_cnt;
+extern volatile uint32_t hal_ina;
+extern volatile uint32_t hal_outa;
+extern volatile uint32_t hal_dira;
+#define CNT hal_cnt
+#define INA hal_ina
+#define OUTA hal_outa
+#define DIRA hal_dira
+
+extern unsigned int _clkfreq;
+#define CLKFREQ _clkfreq
+
+/* Advances the simulated time, and the plant, up to CNT == t. */
+void __napuntil(unsigned int t);
+#define waitcnt(t) __napuntil(t)
+
+/* Counters, only the NCO single-ended mode is simulated. */
+void hal_ctr_write(int ctr, uint32_t mode, uint32_t frq, uint32_t phs);
+
+/* The simulator runs the cogs' steps itself, cogstart() only counts. */
+#define EXTRA_STACK_BYTES 0
+int cogstart(void (*func)(void*), void* par, void* stack, size_t stacksize);
+
+/* 1-Wire bus, backed by simulated DS18B20. */
+int8_t ow_reset(uint8_t pin);
+void ow_command(uint8_t command, uint8_t pin);
+uint8_t ow_read_byte(uint8_t pin);
+void ow_write_byte(uint8_t byte, uint8_t pin);
+uint8_t ow_read_bit(uint8_t pin);
+void ow_write_bit(uint8_t bit, uint8_t pin);
+#define ow_input_pin_state(pin) 1
+
+#endif /* VEGIMETER_HOST */
+
+#endif /* __VEGIMETER2_HAL_H */
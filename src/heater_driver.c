@@ -14,6 +14,7 @@
  */
 
 #include <vegimeter.h>
+#include "serial.h"
 
 void
 heater_driver_runner(unsigned heater_on)
@@ -21,11 +22,11 @@ heater_driver_runner(unsigned heater_on)
   if (heater_on)
     {
       lh1500_on(13); /* Heater */
-      printf("  >>> Heater ON! <<<\n");
+      serial_puts(&serial_console, "  >>> Heater ON! <<<\n");
     }
   else
     {
       lh1500_off(13); /* Heater */
-      printf("  >>> Heater OFF! <<<\n");
+      serial_puts(&serial_console, "  >>> Heater OFF! <<<\n");
     }
 }
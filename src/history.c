@@ -0,0 +1,196 @@
+/*
+ * Vegimeter 2 EEPROM history log
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "eeprom.h"
+#include "frame.h"
+#include "history.h"
+
+#define PAGE_CRC 2
+#define PAGE_SEQ 4
+#define PAGE_BOOT 8
+#define PAGE_TIME 10
+#define PAGE_USED 14
+
+#define PAGE_ADDR(i) (HISTORY_BASE + (uint16_t)(i) * EEPROM_PAGE_SIZE)
+
+HUBDATA static uint8_t history_page[EEPROM_PAGE_SIZE];
+HUBDATA static uint8_t history_used; /* Record bytes in the page buffer */
+HUBDATA static uint16_t history_next; /* Where the page buffer goes */
+HUBDATA static uint32_t history_seq;
+HUBDATA static uint16_t history_boot;
+/* The previous record of the page. */
+HUBDATA static uint32_t history_time;
+HUBDATA static int16_t history_duty;
+HUBDATA static int16_t history_temp[NUM_SENSORS];
+/* Next page to dump, HISTORY_NUM_PAGES for the page buffer. */
+HUBDATA static int16_t history_dump = -1;
+
+static void put_u16(uint8_t* p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+  put_u16(p, v & 0xFFFF);
+  put_u16(p + 2, v >> 16);
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint8_t put_varint(uint8_t* p, uint32_t v) {
+  uint8_t n = 0;
+
+  while (v >= 0x80) {
+    p[n++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  p[n++] = v;
+  return n;
+}
+
+static uint8_t put_zigzag(uint8_t* p, int32_t v) {
+  return put_varint(p, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+/* Same as in FRAME_STATUS. */
+static int16_t history_temp_value(int temp) {
+  if (temp == DEFAULT_TEMP_READING || temp < -32767 || temp > 32767) {
+    return FRAME_NO_READING;
+  }
+  return temp;
+}
+
+/* Fills in the header fields that change with the records. */
+static void history_seal(uint8_t* page) {
+  uint16_t crc = 0xFFFF;
+  uint8_t i;
+
+  page[PAGE_USED] = history_used;
+  for (i = PAGE_SEQ; i < HISTORY_HEADER_SIZE + history_used; i++) {
+    crc = crc16_update(crc, page[i]);
+  }
+  put_u16(page + PAGE_CRC, crc);
+}
+
+static int8_t history_valid(const uint8_t* header) {
+  return header[0] == HISTORY_MAGIC && header[1] == HISTORY_VERSION;
+}
+
+/* Finds the newest page, the log goes on after it. */
+void history_init() {
+  uint8_t header[HISTORY_HEADER_SIZE];
+  int8_t found = 0;
+  uint32_t seq;
+  uint16_t i;
+
+  eeprom_init();
+  history_next = 0;
+  history_seq = 0;
+  history_boot = 0;
+  for (i = 0; i < HISTORY_NUM_PAGES; i++) {
+    if (eeprom_read(PAGE_ADDR(i), header, sizeof(header)) ||
+        !history_valid(header)) {
+      continue;
+    }
+    seq = get_u32(header + PAGE_SEQ);
+    if (!found || (int32_t)(seq - history_seq) >= 0) {
+      found = 1;
+      history_next = (i + 1) % HISTORY_NUM_PAGES;
+      history_seq = seq + 1;
+      history_boot = (header[PAGE_BOOT] | (header[PAGE_BOOT + 1] << 8)) + 1;
+    }
+  }
+  history_used = 0;
+  history_dump = -1;
+}
+
+static void history_flush() {
+  history_seal(history_page);
+  eeprom_write_page(PAGE_ADDR(history_next), history_page,
+                    EEPROM_PAGE_SIZE);
+  history_next = (history_next + 1) % HISTORY_NUM_PAGES;
+  history_seq++;
+  if (history_dump > 0) {
+    /* The pages still to dump moved one closer to the oldest. */
+    history_dump--;
+  }
+  history_used = 0;
+}
+
+void history_append(struct control_snapshot* c, uint32_t t) {
+  uint8_t record[HISTORY_RECORD_MAX_SIZE];
+  uint8_t n, i;
+  int16_t temp;
+
+  if (history_used > 0 && history_used + HISTORY_RECORD_MAX_SIZE >
+      EEPROM_PAGE_SIZE - HISTORY_HEADER_SIZE) {
+    history_flush();
+  }
+  if (history_used == 0) {
+    /* A new page, the deltas start from zero. */
+    history_page[0] = HISTORY_MAGIC;
+    history_page[1] = HISTORY_VERSION;
+    put_u32(history_page + PAGE_SEQ, history_seq);
+    put_u16(history_page + PAGE_BOOT, history_boot);
+    put_u32(history_page + PAGE_TIME, t);
+    history_time = t;
+    history_duty = 0;
+    for (i = 0; i < NUM_SENSORS; i++) {
+      history_temp[i] = 0;
+    }
+  }
+
+  n = put_varint(record, t - history_time);
+  record[n++] = (c->heater ? HISTORY_FLAG_HEATER : 0) |
+                (c->pump ? HISTORY_FLAG_PUMP : 0) |
+                (c->action << HISTORY_FLAG_ACTION_SHIFT) |
+                (c->halt << HISTORY_FLAG_HALT_SHIFT);
+  n += put_zigzag(record + n, c->heater_duty - history_duty);
+  for (i = 0; i < NUM_SENSORS; i++) {
+    temp = history_temp_value(c->temp[i]);
+    n += put_zigzag(record + n, temp - history_temp[i]);
+    history_temp[i] = temp;
+  }
+  history_time = t;
+  history_duty = c->heater_duty;
+
+  memcpy(history_page + HISTORY_HEADER_SIZE + history_used, record, n);
+  history_used += n;
+}
+
+void history_dump_begin() {
+  history_dump = 0;
+}
+
+int8_t history_dumping() {
+  return history_dump >= 0;
+}
+
+void history_dump_next(uint8_t* page) {
+  uint16_t i;
+
+  while (history_dump < HISTORY_NUM_PAGES) {
+    i = (history_next + history_dump++) % HISTORY_NUM_PAGES;
+    if (!eeprom_read(PAGE_ADDR(i), page, EEPROM_PAGE_SIZE) &&
+        history_valid(page)) {
+      return;
+    }
+  }
+  memcpy(page, history_page, EEPROM_PAGE_SIZE);
+  if (history_used == 0) {
+    /* Nothing in the buffer, an empty page of this boot. */
+    page[0] = HISTORY_MAGIC;
+    page[1] = HISTORY_VERSION;
+    put_u32(page + PAGE_SEQ, history_seq);
+    put_u16(page + PAGE_BOOT, history_boot);
+    put_u32(page + PAGE_TIME, history_time);
+  }
+  history_seal(page);
+  history_dump = -1;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_HISTORY_H
+#define __VEGIMETER2_HISTORY_H
+
+#include <stdint.h>
+#include "eeprom.h"
+#include "engine.h"
+
+/*
+ * History log of the control snapshots in the upper half of the EEPROM, so
+ * the data survives an XBee outage.
+ *
+ * The log is a ring of EEPROM pages. Records are collected in a page
+ * buffer in hub RAM and only whole pages are written, one write cycle per
+ * page, each time to the page after the newest one. So every page is
+ * written once per lap of the ring: with a record a minute and about eight
+ * records a page that is once every 33 hours, far from the 1M cycles the
+ * 24LC512 is rated for. A power loss costs the page buffer, at most eight
+ * minutes of records.
+ *
+ * Page layout, little endian:
+ *   0  magic     HISTORY_MAGIC
+ *   1  version   HISTORY_VERSION
+ *   2  crc       uint16, CRC-16/CCITT of bytes 4 through the last record
+ *   4  seq       uint32, page number since the log was created
+ *   8  boot      uint16, boots since the log was created
+ *  10  time      uint32, seconds since boot of the first record
+ *  14  used      record bytes
+ *  15  records
+ *
+ * Record, varint is LEB128 and zigzag the signed mapping of protobuf:
+ *   varint     seconds since the previous record, 0 for the first one
+ *   uint8      bit 0 heater, bit 1 pump, bits 2-4 action, bits 5-7 halt
+ *   zigzag     heater duty
+ *   zigzag[]   temperature of each role, as in FRAME_STATUS
+ * The duty and the temperatures are deltas from the previous record of
+ * the page, the first record of a page stands alone.
+ */
+#define HISTORY_BASE EEPROM_USER_BASE
+/* The last pages of the EEPROM are left to others. */
+#define HISTORY_NUM_PAGES 248
+#define HISTORY_MAGIC 0x48
+#define HISTORY_VERSION 1
+#define HISTORY_HEADER_SIZE 15
+#define HISTORY_RECORD_MAX_SIZE (5 + 1 + 3 + 3 * NUM_SENSORS)
+
+#define HISTORY_FLAG_HEATER 0x01
+#define HISTORY_FLAG_PUMP 0x02
+#define HISTORY_FLAG_ACTION_SHIFT 2
+#define HISTORY_FLAG_HALT_SHIFT 5
+
+/* Only the telemetry cog uses the log. */
+void history_init();
+/* Records a snapshot taken t seconds after boot. */
+void history_append(struct control_snapshot* c, uint32_t t);
+
+/*
+ * Bulk dump: the valid pages from the oldest to the newest, then the page
+ * buffer. history_dump_next() copies the next one into page, the dump is
+ * over once it returned the page buffer.
+ */
+void history_dump_begin();
+void history_dump_next(uint8_t* page);
+int8_t history_dumping();
+
+#endif /* __VEGIMETER2_HISTORY_H */
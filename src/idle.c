@@ -0,0 +1,49 @@
+/*
+ * Vegimeter 2 low-power idle
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "idle.h"
+#include "mailbox.h"
+
+HUBDATA struct idle_mailbox idle_mailbox[IDLE_NUM_COGS];
+/* CNT when the cog last woke up, only used by the cog itself. */
+HUBDATA static uint32_t idle_woke[IDLE_NUM_COGS];
+HUBDATA static int8_t idle_started[IDLE_NUM_COGS];
+
+void idle_until(int8_t cog, unsigned int t) {
+  struct idle_mailbox* mb = &idle_mailbox[cog];
+  unsigned int before = CNT;
+  unsigned int after;
+
+  if ((int)(t - before) < IDLE_MIN_NAP) {
+    return;
+  }
+  __napuntil(t);
+  after = CNT;
+
+  mailbox_write_begin(mb);
+  if (idle_started[cog]) {
+    mb->data.awake += before - idle_woke[cog];
+  }
+  mb->data.asleep += after - before;
+  mb->data.naps++;
+  mailbox_write_end(mb);
+  idle_woke[cog] = after;
+  idle_started[cog] = 1;
+}
+
+void idle_ms(int8_t cog, unsigned int ms) {
+  unsigned int millisecond = CLKFREQ / 1000;
+  unsigned int t = CNT;
+  unsigned int chunk;
+
+  while (ms > 0) {
+    chunk = ms < IDLE_MAX_MS ? ms : IDLE_MAX_MS;
+    t += chunk * millisecond;
+    ms -= chunk;
+    idle_until(cog, t);
+  }
+}
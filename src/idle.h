@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_IDLE_H
+#define __VEGIMETER2_IDLE_H
+
+#include <stdint.h>
+#include "mailbox.h"
+/* The cogs with an idle account, IDLE_*. */
+#include "vegimeter2_tables.h"
+
+/*
+ * Longest single nap, milliseconds. CNT wraps every 53 s at 80 MHz and
+ * deadlines are compared as signed differences, so longer waits are taken
+ * in chunks of this size.
+ */
+#define IDLE_MAX_MS 10000
+
+/* Closer deadlines are not worth a nap, cycles. A waitcnt on a deadline
+ * that already passed would sleep for a whole CNT wrap. */
+#define IDLE_MIN_NAP 1000
+
+/*
+ * Idle accounting. The cogs sleep in waitcnt, which stops them and cuts
+ * their power draw, for as long as they can in one go. Each cog counts the
+ * cycles it spent awake and asleep in its own mailbox.
+ */
+struct idle_stats {
+  uint64_t awake; /* Cycles */
+  uint64_t asleep; /* Cycles */
+  uint32_t naps;
+};
+
+struct idle_mailbox {
+  volatile uint32_t seq;
+  struct idle_stats data;
+};
+
+extern struct idle_mailbox idle_mailbox[IDLE_NUM_COGS];
+
+/* Sleeps until CNT == t, at most 2^31 cycles ahead. */
+void idle_until(int8_t cog, unsigned int t);
+void idle_ms(int8_t cog, unsigned int ms);
+
+#endif /* __VEGIMETER2_IDLE_H */
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_MAILBOX_H
+#define __VEGIMETER2_MAILBOX_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Versioned snapshot mailboxes for passing data between cogs without locks.
+ *
+ * A mailbox is any struct that starts with a "volatile uint32_t seq" field
+ * followed by a "data" field, and has exactly one writer cog. The writer
+ * makes seq odd while it updates the data and even again when it is done.
+ * A reader copies the data and retries until it saw the same even seq
+ * before and after the copy, so it never blocks the writer. seq / 2 is the
+ * version of the snapshot, 0 means that nothing was published yet.
+ */
+
+#define mailbox_barrier() __asm__ __volatile__("" ::: "memory")
+
+#define mailbox_write_begin(mb)                 \
+  do {                                          \
+    (mb)->seq++;                                \
+    mailbox_barrier();                          \
+  } while (0)
+
+#define mailbox_write_end(mb)                   \
+  do {                                          \
+    mailbox_barrier();                          \
+    (mb)->seq++;                                \
+  } while (0)
+
+/* Copies the data out of the mailbox and returns its seq. */
+#define mailbox_read(mb, copy)                                  \
+  mailbox_read_data(&(mb)->seq, (const void*)&(mb)->data, (copy), \
+                    sizeof((mb)->data))
+
+static inline uint32_t mailbox_read_data(volatile uint32_t* seq,
+                                         const void* data, void* copy,
+                                         size_t size) {
+  uint32_t s;
+
+  do {
+    while ((s = *seq) & 1) {
+    }
+    mailbox_barrier();
+    memcpy(copy, data, size);
+    mailbox_barrier();
+  } while (s != *seq);
+  return s;
+}
+
+#endif /* __VEGIMETER2_MAILBOX_H */
@@ -18,6 +18,13 @@
 #include <bb/os.h>
 #include <bb/os/kernel/delay.h>
 #include <vegimeter.h>
+#include "fmt.h"
+#include "onewire_cog.h"
+#include "sensors.h"
+#include "serial.h"
+
+/* The sensors go through the 1-Wire coprocessor, see onewire_cog.h. */
+HUBDATA static int onewire_stack[ONEWIRE_STACK_SIZE];
 
 int
 main()
@@ -31,8 +38,14 @@ main()
   int soil_temperature_d = 0;
   unsigned heater_on = 0;
   unsigned pump_on = 0;
+  char line[32];
+  char* p;
 
-  printf("Starting Vegimeter!\n");
+  serial_console_open();
+  serial_puts(&serial_console, "Starting Vegimeter!\n");
+  cogstart(ow_cog_runner, NULL, onewire_stack, sizeof(onewire_stack));
+  /* Loads the generated sensor table and discovers the probes. */
+  sensors_init();
 
   do {
     controller_runner(water_temperature, soil_temperature_a, soil_temperature_b,
@@ -45,17 +58,23 @@ main()
     heater_driver_runner(heater_on);
     pump_driver_runner(pump_on);
 
-    water_temperature = temp_sensor_driver_water_runner();
-    soil_temperature_a = temp_sensor_driver_soil_a_runner();
-    soil_temperature_b = temp_sensor_driver_soil_b_runner();
-    soil_temperature_c = temp_sensor_driver_soil_c_runner();
-    soil_temperature_d = temp_sensor_driver_soil_d_runner();
+    /* One conversion window for every probe. */
+    bbos_delay_msec(sensors_start_conversion());
+    sensors_read_all();
+    water_temperature = sensors_get_temp(SENSOR_WATER_A);
+    soil_temperature_a = sensors_get_temp(SENSOR_SOIL_A);
+    soil_temperature_b = sensors_get_temp(SENSOR_SOIL_B);
+    soil_temperature_c = sensors_get_temp(SENSOR_SOIL_C);
+    soil_temperature_d = sensors_get_temp(SENSOR_SOIL_D);
 
     ui_runner(water_temperature, soil_temperature_a, soil_temperature_b,
               soil_temperature_c, soil_temperature_d,
               soil_temperature_d, vegimeter_buttons);
 
-    printf("Sleeping for %d ms\n", delay);
+    p = fmt_str(line, "Sleeping for ");
+    p = fmt_uint(p, delay);
+    fmt_str(p, " ms\n");
+    serial_puts(&serial_console, line);
     bbos_delay_msec(delay);
   } while(1);
 
@@ -0,0 +1,149 @@
+/*
+ * Vegimeter 2 thermal model
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "model.h"
+
+/* Fraction bits of the temperatures in model_predict(), so that the small
+ * changes of the soil per period add up. */
+#define PREDICT_Q 8
+
+void model_init(struct model* m) {
+  memset(m, 0, sizeof(*m));
+  rls_init(&m->soil);
+  rls_init(&m->water);
+}
+
+void model_warm(struct model* m, const int32_t* soil, const int32_t* water) {
+  memcpy(m->warm_soil, soil, sizeof(m->warm_soil));
+  memcpy(m->warm_water, water, sizeof(m->warm_water));
+  memcpy(m->soil.theta, soil, sizeof(m->soil.theta));
+  memcpy(m->water.theta, water, sizeof(m->water.theta));
+  m->soil.solved = m->water.solved = 1;
+  m->warm = 1;
+}
+
+void model_step(struct model* m, int air, int soil, int water, int duty,
+                int8_t pump) {
+  if (m->periods == MODEL_PERIODS) {
+    rls_update(&m->soil, m->soil_x, soil - m->soil_start);
+    rls_update(&m->water, m->water_x, water - m->water_start);
+    m->periods = 0;
+    if (m->warm && m->soil.n < MODEL_MIN_SAMPLES) {
+      memcpy(m->soil.theta, m->warm_soil, sizeof(m->soil.theta));
+      memcpy(m->water.theta, m->warm_water, sizeof(m->water.theta));
+    } else {
+      m->warm = 0;
+    }
+  }
+  if (m->periods == 0) {
+    memset(m->soil_x, 0, sizeof(m->soil_x));
+    memset(m->water_x, 0, sizeof(m->water_x));
+    m->soil_start = soil;
+    m->water_start = water;
+  }
+  m->soil_x[MODEL_SOIL_AIR] += air - soil;
+  m->soil_x[MODEL_SOIL_WATER] += pump ? water - soil : 0;
+  m->soil_x[MODEL_SOIL_BIAS] += MODEL_BIAS;
+  m->water_x[MODEL_WATER_HEATER] += duty;
+  m->water_x[MODEL_WATER_AIR] += air - water;
+  m->water_x[MODEL_WATER_SOIL] += pump ? soil - water : 0;
+  m->periods++;
+
+  m->air_sum += air;
+  if (++m->air_periods == MODEL_HOUR_PERIODS) {
+    m->air_day[m->hour] = m->air_sum / MODEL_HOUR_PERIODS;
+    m->hour = (m->hour + 1) % MODEL_DAY_HOURS;
+    if (m->hours < MODEL_DAY_HOURS) {
+      m->hours++;
+    }
+    m->air_sum = 0;
+    m->air_periods = 0;
+  }
+}
+
+int8_t model_valid(const struct model* m) {
+  const int32_t* s = m->soil.theta;
+  const int32_t* w = m->water.theta;
+
+  return m->soil.solved && m->water.solved &&
+    (m->warm || (m->soil.n >= MODEL_MIN_SAMPLES &&
+                 m->water.n >= MODEL_MIN_SAMPLES)) &&
+    s[MODEL_SOIL_AIR] > 0 && s[MODEL_SOIL_WATER] > 0 &&
+    w[MODEL_WATER_HEATER] > 0 && w[MODEL_WATER_AIR] >= 0 &&
+    w[MODEL_WATER_SOIL] > 0;
+}
+
+/*
+ * Runs the model for periods from *ts and *tw, in PREDICT_Q, with the air
+ * at ta and the water at tw_max at most. Returns the lowest soil.
+ */
+static int32_t model_run(const struct model* m, int32_t ta, int32_t* ts,
+                         int32_t* tw, int duty, int periods, int32_t tw_max) {
+  int32_t x[RLS_N];
+  int32_t dts, lowest = *ts;
+
+  while (periods-- > 0) {
+    x[MODEL_SOIL_AIR] = ta - *ts;
+    x[MODEL_SOIL_WATER] = *tw - *ts;
+    x[MODEL_SOIL_BIAS] = MODEL_BIAS << PREDICT_Q;
+    dts = rls_predict(&m->soil, x);
+    x[MODEL_WATER_HEATER] = duty << PREDICT_Q;
+    x[MODEL_WATER_AIR] = ta - *tw;
+    x[MODEL_WATER_SOIL] = *ts - *tw;
+    *tw += rls_predict(&m->water, x);
+    *tw = *tw < tw_max ? *tw : tw_max;
+    *ts += dts;
+    lowest = *ts < lowest ? *ts : lowest;
+  }
+  return lowest;
+}
+
+int model_predict(const struct model* m, int air, int soil, int water,
+                  int duty, int8_t horizon) {
+  int32_t ts = (int32_t)soil << PREDICT_Q;
+  int32_t tw = (int32_t)water << PREDICT_Q;
+
+  model_run(m, (int32_t)air << PREDICT_Q, &ts, &tw, duty, horizon,
+            INT32_MAX);
+  return ts >> PREDICT_Q;
+}
+
+int model_lowest(const struct model* m, int air, int soil, int water,
+                 int duty, int water_max, int8_t hours) {
+  int32_t ts = (int32_t)soil << PREDICT_Q;
+  int32_t tw = (int32_t)water << PREDICT_Q;
+  int32_t ta, low, lowest = INT32_MAX;
+  int8_t h;
+
+  for (h = 0; h < hours; h++) {
+    ta = air;
+    if (m->hours == MODEL_DAY_HOURS) {
+      ta += m->air_day[(m->hour + h) % MODEL_DAY_HOURS] - m->air_day[m->hour];
+    }
+    low = model_run(m, ta << PREDICT_Q, &ts, &tw, duty, MODEL_HOUR_PERIODS,
+                    (int32_t)water_max << PREDICT_Q);
+    if (h > 0) {
+      lowest = low < lowest ? low : lowest;
+    }
+  }
+  return lowest >> PREDICT_Q;
+}
+
+int model_duty(const struct model* m, int air, int soil, int water,
+               int setpoint, int8_t horizon) {
+  int off = model_predict(m, air, soil, water, 0, horizon);
+  int on = model_predict(m, air, soil, water, ACTUATOR_DUTY_MAX, horizon);
+
+  /* The model is linear, so is the soil in the duty. */
+  if (off >= setpoint) {
+    return 0;
+  }
+  if (on <= setpoint) {
+    return ACTUATOR_DUTY_MAX;
+  }
+  return (int32_t)(setpoint - off) * ACTUATOR_DUTY_MAX / (on - off);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_MODEL_H
+#define __VEGIMETER2_MODEL_H
+
+#include <stdint.h>
+#include "actuator.h"
+#include "rls.h"
+
+/*
+ * Thermal model of the soil and the water tank, identified online from the
+ * readings of the control loop. Per polling period, in centi-Celsius:
+ *
+ *   soil  += a (air - soil) + b pump (water - soil) + c
+ *   water += d duty + e (air - water) + f pump (soil - water)
+ *
+ * a is the loss of the soil to the air and b the transfer from the water
+ * through the coil, both over the heat capacity of the soil, c the heat
+ * from elsewhere (the sun, the pump). d is the heater over the capacity of
+ * the water, in centi-Celsius per permille. Each equation has its own
+ * estimator, updated once per sample of MODEL_PERIODS polling periods: the
+ * change of the temperature over the sample against the regressors summed
+ * over it, so the quantization of the readings is spread over the sample.
+ *
+ * The air temperature of the last day is kept by the hour, so that a
+ * forecast can follow the daily swing: the air an hour from now is taken
+ * to change as much as it did from this hour to the next a day ago.
+ */
+#define MODEL_PERIODS 10 /* Polling periods per sample */
+/* Samples before the model is trusted, 6 hours. */
+#define MODEL_MIN_SAMPLES 36
+/* Regressor of c, per polling period, so c is in centi-Celsius per 1 C. */
+#define MODEL_BIAS 100
+#define MODEL_HOUR_PERIODS 60 /* Polling periods per hour */
+#define MODEL_DAY_HOURS 24
+
+#define MODEL_SOIL_AIR 0 /* a */
+#define MODEL_SOIL_WATER 1 /* b */
+#define MODEL_SOIL_BIAS 2 /* c */
+#define MODEL_WATER_HEATER 0 /* d */
+#define MODEL_WATER_AIR 1 /* e */
+#define MODEL_WATER_SOIL 2 /* f */
+
+struct model {
+  struct rls soil;
+  struct rls water;
+  /* The sample so far */
+  int32_t soil_x[RLS_N];
+  int32_t water_x[RLS_N];
+  int soil_start; /* Centi-Celsius */
+  int water_start; /* Centi-Celsius */
+  uint8_t periods;
+  /* Restored solution, see model_warm() */
+  int32_t warm_soil[RLS_N];
+  int32_t warm_water[RLS_N];
+  int8_t warm;
+  /* Hourly means of the air, the oldest at hour */
+  int16_t air_day[MODEL_DAY_HOURS]; /* Centi-Celsius */
+  int32_t air_sum;
+  uint8_t air_periods;
+  uint8_t hour;
+  uint8_t hours; /* Saturated at MODEL_DAY_HOURS */
+};
+
+void model_init(struct model* m);
+/*
+ * Warm restart with the parameters of a valid model. They stand until the
+ * estimators have MODEL_MIN_SAMPLES of their own, as many as a cold start
+ * waits for, so that a solve of nearly empty normal equations never
+ * replaces them.
+ */
+void model_warm(struct model* m, const int32_t* soil, const int32_t* water);
+/*
+ * Control cog, once per polling period: the temperatures at its start and
+ * the heater duty (permille) and pump it runs with.
+ */
+void model_step(struct model* m, int air, int soil, int water, int duty,
+                int8_t pump);
+/* Enough samples or a restored model, and a solution that makes physical
+ * sense. */
+int8_t model_valid(const struct model* m);
+/* Soil temperature in horizon polling periods, with the heater at duty and
+ * the pump on. */
+int model_predict(const struct model* m, int air, int soil, int water,
+                  int duty, int8_t horizon);
+/*
+ * Lowest soil temperature from an hour to hours from now, the first hour
+ * being model_duty()'s, with the heater at duty, the water held at
+ * water_max at most as the heater derating does, and the air of the
+ * forecast, or the current one until there is a day of history.
+ */
+int model_lowest(const struct model* m, int air, int soil, int water,
+                 int duty, int water_max, int8_t hours);
+/*
+ * Heater duty, permille, that brings the soil to setpoint in horizon
+ * polling periods: none if the heat in the water gets it there, full if
+ * even that falls short.
+ */
+int model_duty(const struct model* m, int air, int soil, int water,
+               int setpoint, int8_t horizon);
+
+#endif /* __VEGIMETER2_MODEL_H */
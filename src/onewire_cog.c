@@ -0,0 +1,264 @@
+/*
+ * Vegimeter 2 1-Wire coprocessor
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "idle.h"
+#include "mailbox.h"
+#include "onewire_cog.h"
+#include "onewire_rom.h"
+#include "pins.h"
+
+#define NUM_PINS 32
+
+HUBDATA struct ow_queue ow_queue;
+HUBDATA static struct ow_request* ow_batch[NUM_PINS];
+HUBDATA static uint8_t ow_out[NUM_PINS];
+HUBDATA static uint8_t ow_in[NUM_PINS];
+
+int8_t ow_submit(struct ow_request* r) {
+  uint32_t head = ow_queue.head;
+
+  if (head - ow_queue.tail >= OW_QUEUE_SIZE) {
+    return -1;
+  }
+  r->status = OW_PENDING;
+  ow_queue.requests[head & OW_QUEUE_MASK] = r;
+  mailbox_barrier();
+  ow_queue.head = head + 1;
+  return 0;
+}
+
+int8_t ow_poll(struct ow_request* r) {
+  return r->status;
+}
+
+int8_t ow_wait(struct ow_request* r) {
+  while (r->status == OW_PENDING) {
+#ifdef VEGIMETER_HOST
+    /* The simulator has no coprocessor cog, the client runs it. */
+    ow_cog_poll();
+#else
+    idle_ms(IDLE_SENSORS, 1);
+#endif
+  }
+  return r->status;
+}
+
+static void ow_complete(struct ow_request* r, int8_t status) {
+  mailbox_barrier();
+  r->status = status;
+}
+
+/*
+ * Byte k of the transaction: the ROM command and ID, the function command,
+ * then data[] to write or read into. Returns -1 past the end.
+ */
+static int ow_transaction_byte(struct ow_request* r, uint8_t k,
+                               int8_t* read) {
+  uint8_t rom_len = r->flags & OW_SKIP ? 1 : 1 + OW_ROM_SIZE;
+
+  *read = 0;
+  if (k == 0) {
+    return r->flags & OW_SKIP ? OW_SKIP_ROM : OW_MATCH_ROM;
+  }
+  if (k < rom_len) {
+    return r->rom[k - 1];
+  }
+  if (k == rom_len) {
+    return r->command;
+  }
+  k -= rom_len + 1;
+  if (k < r->num_write) {
+    return r->data[k];
+  }
+  if (k < r->num_write + r->num_read) {
+    *read = 1;
+    return 0xFF;
+  }
+  return -1;
+}
+
+/* Transactions on distinct pins, in lockstep. */
+static void ow_run_batch(int8_t n, uint32_t pins) {
+  struct ow_request* r;
+  uint32_t active, mask, read_mask;
+  uint8_t k, j;
+  int8_t i, read;
+  int b;
+
+  active = ow_reset_pins(pins);
+  for (i = 0; i < n; i++) {
+    if (!(active & GET_MASK(ow_batch[i]->pin))) {
+      ow_complete(ow_batch[i], OW_NO_PRESENCE);
+    }
+  }
+  for (k = 0; active; k++) {
+    mask = read_mask = 0;
+    for (i = 0; i < n; i++) {
+      r = ow_batch[i];
+      if (!(active & GET_MASK(r->pin))) {
+        continue;
+      }
+      b = ow_transaction_byte(r, k, &read);
+      if (b < 0) {
+        active &= ~GET_MASK(r->pin);
+        ow_complete(r, OW_DONE);
+        continue;
+      }
+      mask |= GET_MASK(r->pin);
+      read_mask |= read ? GET_MASK(r->pin) : 0;
+      ow_out[r->pin] = b;
+    }
+    if (!mask) {
+      break;
+    }
+    ow_byte_pins(mask, read_mask, ow_out, ow_in);
+    for (i = 0; i < n; i++) {
+      r = ow_batch[i];
+      if (read_mask & GET_MASK(r->pin)) {
+        j = k - (r->flags & OW_SKIP ? 2 : 2 + OW_ROM_SIZE);
+        r->data[j] = ow_in[r->pin];
+      }
+    }
+  }
+}
+
+int8_t ow_cog_poll() {
+  uint32_t tail = ow_queue.tail;
+  uint32_t head = ow_queue.head;
+  uint32_t pins = 0;
+  struct ow_request* r;
+  int8_t n = 0;
+
+  if (tail == head) {
+    return 0;
+  }
+  mailbox_barrier();
+  r = ow_queue.requests[tail & OW_QUEUE_MASK];
+  if (r->op == OW_OP_SEARCH) {
+    r->num_roms = ow_search_rom(r->pin, r->roms, r->max_roms);
+    ow_complete(r, OW_DONE);
+    ow_queue.tail = tail + 1;
+    return 1;
+  }
+  /* Up to the first request on a pin that is already taken. */
+  while (tail != head) {
+    r = ow_queue.requests[tail & OW_QUEUE_MASK];
+    if (r->op != OW_OP_TRANSACTION || (pins & GET_MASK(r->pin))) {
+      break;
+    }
+    pins |= GET_MASK(r->pin);
+    ow_batch[n++] = r;
+    tail++;
+  }
+  ow_run_batch(n, pins);
+  ow_queue.tail = tail;
+  return 1;
+}
+
+void ow_cog_runner(void* par) {
+  while (1) {
+    if (!ow_cog_poll()) {
+      idle_ms(IDLE_ONEWIRE, OW_COG_POLL_PERIOD);
+    }
+  }
+}
+
+#ifndef VEGIMETER_HOST
+/* Standard speed, microseconds. */
+#define OW_RESET_LOW 480
+#define OW_PRESENCE_SAMPLE 70
+#define OW_RESET_RECOVERY 410
+#define OW_SLOT_RELEASE 6 /* Writing a one or reading */
+#define OW_SLOT_SAMPLE 13
+#define OW_SLOT_LOW 60 /* Writing a zero */
+#define OW_SLOT 65 /* With the recovery */
+#define OW_SLOT_SETUP 20 /* Before the first slot */
+
+/* Slot timing in cycles. Multiplication is a library call, which native
+ * code in the fcache cannot make. */
+struct ow_timing {
+  unsigned int release;
+  unsigned int sample;
+  unsigned int low;
+  unsigned int slot;
+  unsigned int setup;
+};
+
+uint32_t ow_reset_pins(uint32_t mask) {
+  unsigned int us = CLKFREQ / 1000000;
+  unsigned int t;
+  uint32_t presence;
+
+  OUT_LOW_MASK(mask);
+  t = CNT;
+  DIR_OUTPUT_MASK(mask);
+  waitcnt(t += OW_RESET_LOW * us);
+  DIR_INPUT_MASK(mask);
+  waitcnt(t += OW_PRESENCE_SAMPLE * us);
+  presence = ~INA & mask;
+  waitcnt(t += OW_RESET_RECOVERY * us);
+  /* A shorted bus is still low. */
+  return presence & INA;
+}
+
+/*
+ * Eight time slots on all the pins at once. Runs natively from the cog's
+ * fcache, so the 1-15 us windows do not depend on the LMM kernel or the
+ * hub. The pins in ones[i] let go early in slot i, they write a one or
+ * read, INA is sampled into samples[i].
+ */
+__attribute__((fcache)) static void ow_slots(uint32_t mask,
+                                             const uint32_t* ones,
+                                             uint32_t* samples,
+                                             const struct ow_timing* timing) {
+  unsigned int t = CNT + timing->setup;
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    waitcnt(t);
+    DIRA |= mask;
+    waitcnt(t + timing->release);
+    DIRA &= ~ones[i];
+    waitcnt(t + timing->sample);
+    samples[i] = INA;
+    waitcnt(t + timing->low);
+    DIRA &= ~mask;
+    t += timing->slot;
+  }
+}
+
+void ow_byte_pins(uint32_t mask, uint32_t read_mask, const uint8_t* out,
+                  uint8_t* in) {
+  unsigned int us = CLKFREQ / 1000000;
+  struct ow_timing timing = {
+    OW_SLOT_RELEASE * us, OW_SLOT_SAMPLE * us, OW_SLOT_LOW * us,
+    OW_SLOT * us, OW_SLOT_SETUP * us
+  };
+  uint32_t ones[8], samples[8];
+  int8_t i, pin;
+
+  for (i = 0; i < 8; i++) {
+    ones[i] = read_mask;
+    for (pin = 0; pin < NUM_PINS; pin++) {
+      if ((mask & GET_MASK(pin)) && (out[pin] >> i & 1)) {
+        ones[i] |= GET_MASK(pin);
+      }
+    }
+  }
+  OUT_LOW_MASK(mask);
+  ow_slots(mask, ones, samples, &timing);
+  for (pin = 0; pin < NUM_PINS; pin++) {
+    if (!(read_mask & GET_MASK(pin))) {
+      continue;
+    }
+    in[pin] = 0;
+    for (i = 0; i < 8; i++) {
+      in[pin] |= (samples[i] >> pin & 1) << i;
+    }
+  }
+}
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_ONEWIRE_COG_H
+#define __VEGIMETER2_ONEWIRE_COG_H
+
+#include <stdint.h>
+#include "onewire_rom.h"
+
+/*
+ * 1-Wire coprocessor. A cog of its own owns the 1-Wire pins and does all
+ * the bus timing, the sensing cog hands it requests through a queue in hub
+ * RAM and gets its cycles back.
+ *
+ * Requests on different pins that are queued together run in lockstep:
+ * one reset for all the pins, then every time slot on all of them at once,
+ * each pin writing or reading its own bit. So reading a sensor on each of
+ * seven buses takes about as long as reading one. Requests on the same pin
+ * run in the order they were submitted.
+ */
+
+/* Request operations. */
+#define OW_OP_TRANSACTION 0 /* Reset, select, command, write, read */
+#define OW_OP_SEARCH 1 /* SEARCH ROM, the whole enumeration */
+
+/* Request flags. */
+#define OW_SKIP 0x01 /* SKIP ROM, the slave is alone on the pin */
+
+/* Request status. */
+#define OW_PENDING 0
+#define OW_DONE 1
+#define OW_NO_PRESENCE 2
+
+/* Bytes of a transaction after the command, written then read. */
+#define OW_REQUEST_DATA 10
+/* Must be a power of two. */
+#define OW_QUEUE_SIZE 32
+#define OW_QUEUE_MASK (OW_QUEUE_SIZE - 1)
+
+/* How long the coprocessor naps when the queue is empty. */
+#define OW_COG_POLL_PERIOD 2 // Milliseconds
+
+/*
+ * Owned by the client until ow_submit() and again once the status is no
+ * longer OW_PENDING.
+ */
+struct ow_request {
+  uint8_t op;
+  uint8_t pin;
+  uint8_t flags;
+  uint8_t rom[OW_ROM_SIZE]; /* MATCH ROM unless OW_SKIP */
+  uint8_t command;
+  uint8_t num_write;
+  uint8_t num_read;
+  uint8_t data[OW_REQUEST_DATA]; /* Written first, then read into */
+  /* OW_OP_SEARCH */
+  uint8_t (*roms)[OW_ROM_SIZE];
+  int8_t max_roms;
+  int8_t num_roms; /* Result */
+  volatile int8_t status;
+};
+
+/*
+ * Single producer (the sensing cog), single consumer (the coprocessor).
+ * The indices run freely.
+ */
+struct ow_queue {
+  volatile uint32_t head; /* Moved by the client */
+  volatile uint32_t tail; /* Moved by the coprocessor */
+  struct ow_request* volatile requests[OW_QUEUE_SIZE];
+};
+
+extern struct ow_queue ow_queue;
+
+/* Asynchronous interface. ow_submit() returns -1 if the queue is full. */
+int8_t ow_submit(struct ow_request* r);
+int8_t ow_poll(struct ow_request* r);
+/* Sleeps until the request is done, returns its status. */
+int8_t ow_wait(struct ow_request* r);
+
+/* Coprocessor side: runs the next batch of queued requests, returns 0 if
+ * there was none. */
+int8_t ow_cog_poll();
+void ow_cog_runner(void* par);
+
+/*
+ * Lockstep bus primitives for the pins in mask. ow_reset_pins() returns
+ * the pins that answered with a presence pulse. ow_byte_pins() transfers
+ * a byte on each pin, out and in are indexed by pin and the pins in
+ * read_mask read. They are in onewire_cog.c on the Propeller and in the
+ * simulator on the host.
+ */
+uint32_t ow_reset_pins(uint32_t mask);
+void ow_byte_pins(uint32_t mask, uint32_t read_mask, const uint8_t* out,
+                  uint8_t* in);
+
+#endif /* __VEGIMETER2_ONEWIRE_COG_H */
@@ -0,0 +1,114 @@
+/*
+ * Vegimeter 2 1-Wire ROM commands
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "onewire_rom.h"
+
+/*
+ * Dallas/Maxim CRC8, x^8 + x^5 + x^4 + 1, reflected. The CRC of a byte is
+ * the XOR of the CRCs of its two nibbles, so two 16 entry tables do.
+ */
+HUBDATA static const uint8_t crc8_low[16] = {
+  0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83,
+  0xC2, 0x9C, 0x7E, 0x20, 0xA3, 0xFD, 0x1F, 0x41
+};
+HUBDATA static const uint8_t crc8_high[16] = {
+  0x00, 0x9D, 0x23, 0xBE, 0x46, 0xDB, 0x65, 0xF8,
+  0x8C, 0x11, 0xAF, 0x32, 0xCA, 0x57, 0xE9, 0x74
+};
+
+uint8_t ow_crc8(const uint8_t* data, uint8_t size) {
+  uint8_t crc = 0;
+
+  while (size--) {
+    crc ^= *data++;
+    crc = crc8_low[crc & 0x0F] ^ crc8_high[crc >> 4];
+  }
+  return crc;
+}
+
+int8_t ow_rom_is_null(const uint8_t* rom) {
+  uint8_t i;
+
+  for (i = 0; i < OW_ROM_SIZE; i++) {
+    if (rom[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Maxim AN187 search. Every pass walks the 64 ROM bits; on a discrepancy
+ * (slaves answered both 0 and 1) it takes the 0 branch unless it was
+ * taken on the previous pass, so each pass finds the next ROM ID.
+ */
+int8_t ow_search_rom(uint8_t pin, uint8_t roms[][OW_ROM_SIZE],
+                     int8_t max_devices) {
+  uint8_t rom[OW_ROM_SIZE];
+  uint8_t id_bit, cmp_bit, dir, mask;
+  int8_t bit, last_discrepancy = 0, discrepancy;
+  int8_t num_devices = 0;
+  uint8_t i;
+
+  memset(rom, 0, OW_ROM_SIZE);
+  do {
+    if (ow_reset(pin)) {
+      break;
+    }
+    ow_write_byte(OW_SEARCH_ROM, pin);
+    discrepancy = 0;
+    for (bit = 1; bit <= 64; bit++) {
+      id_bit = ow_read_bit(pin);
+      cmp_bit = ow_read_bit(pin);
+      if (id_bit && cmp_bit) {
+        /* Nobody answered. */
+        return num_devices;
+      }
+      mask = 1 << ((bit - 1) & 7);
+      if (id_bit != cmp_bit) {
+        dir = id_bit;
+      } else {
+        if (bit < last_discrepancy) {
+          dir = (rom[(bit - 1) >> 3] & mask) != 0;
+        } else {
+          dir = (bit == last_discrepancy);
+        }
+        if (!dir) {
+          discrepancy = bit;
+        }
+      }
+      if (dir) {
+        rom[(bit - 1) >> 3] |= mask;
+      } else {
+        rom[(bit - 1) >> 3] &= ~mask;
+      }
+      ow_write_bit(dir, pin);
+    }
+    if (ow_crc8(rom, OW_ROM_SIZE - 1) == rom[OW_ROM_SIZE - 1]) {
+      for (i = 0; i < OW_ROM_SIZE; i++) {
+        roms[num_devices][i] = rom[i];
+      }
+      num_devices++;
+    }
+    last_discrepancy = discrepancy;
+  } while (last_discrepancy && num_devices < max_devices);
+
+  return num_devices;
+}
+
+void ow_match_rom(const uint8_t* rom, uint8_t pin) {
+  uint8_t i;
+
+  ow_write_byte(OW_MATCH_ROM, pin);
+  for (i = 0; i < OW_ROM_SIZE; i++) {
+    ow_write_byte(rom[i], pin);
+  }
+}
+
+void ow_skip_rom(uint8_t pin) {
+  ow_write_byte(OW_SKIP_ROM, pin);
+}
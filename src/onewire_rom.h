@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_ONEWIRE_ROM_H
+#define __VEGIMETER2_ONEWIRE_ROM_H
+
+#include <stdint.h>
+
+/*
+ * ROM level extensions of the onewire_bus layer, so several slaves can share
+ * one bus pin. ow_command() addresses all the slaves at once with SKIP ROM,
+ * the functions below address them one by one.
+ */
+
+/* ROM commands. */
+#define OW_SEARCH_ROM 0xF0
+#define OW_READ_ROM 0x33
+#define OW_MATCH_ROM 0x55
+#define OW_SKIP_ROM 0xCC
+
+/* ROM ID: family code, 48-bit serial number and CRC8. */
+#define OW_ROM_SIZE 8
+#define OW_ROM_FAMILY(rom) ((rom)[0])
+
+#define DS18B20_FAMILY_CODE 0x28
+
+uint8_t ow_crc8(const uint8_t* data, uint8_t size);
+int8_t ow_rom_is_null(const uint8_t* rom);
+/*
+ * Enumerates up to max_devices slaves on the pin with SEARCH ROM and
+ * returns the number of ROM IDs stored into roms. ROM IDs that fail the
+ * CRC check are skipped.
+ */
+int8_t ow_search_rom(uint8_t pin, uint8_t roms[][OW_ROM_SIZE],
+                     int8_t max_devices);
+/* Selects a single slave after a bus reset. */
+void ow_match_rom(const uint8_t* rom, uint8_t pin);
+/* Selects all the slaves after a bus reset. */
+void ow_skip_rom(uint8_t pin);
+
+#endif /* __VEGIMETER2_ONEWIRE_ROM_H */
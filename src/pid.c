@@ -0,0 +1,41 @@
+/*
+ * Vegimeter 2 fixed-point PID controller
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "pid.h"
+
+void pid_reset(struct pid* pid) {
+  pid->integral = 0;
+  pid->prev_error = 0;
+}
+
+int pid_update(struct pid* pid, int error) {
+  int32_t min = (int32_t)pid->out_min << PID_Q;
+  int32_t max = (int32_t)pid->out_max << PID_Q;
+  int32_t pd = pid->kp * error + pid->kd * (error - pid->prev_error);
+  int32_t integral = pid->integral + pid->ki * error;
+  int32_t out;
+
+  if (integral > max) {
+    integral = max;
+  } else if (integral < min) {
+    integral = min;
+  }
+  out = pd + integral;
+  if (!(out > max && error > 0) && !(out < min && error < 0)) {
+    pid->integral = integral;
+  }
+  pid->prev_error = error;
+
+  out = (pd + pid->integral) >> PID_Q;
+  if (out > pid->out_max) {
+    return pid->out_max;
+  }
+  if (out < pid->out_min) {
+    return pid->out_min;
+  }
+  return out;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_PID_H
+#define __VEGIMETER2_PID_H
+
+#include <stdint.h>
+
+/* Gains and the integral are Q8 fixed point. */
+#define PID_Q 8
+#define PID_GAIN(x) ((int32_t)((x) * (1 << PID_Q)))
+
+/*
+ * Fixed-point PID controller, called once per period. The error is in
+ * centi-Celsius and the output is clamped to [out_min, out_max]. The
+ * integral is only updated while that does not push a saturated output
+ * further into saturation (conditional integration). The limits may
+ * change between calls: whatever else holds the output back, the engine's
+ * water limits for instance, goes into them so that the integral does not
+ * wind up against it.
+ */
+struct pid {
+  int32_t kp; /* Output units per centi-Celsius, Q8 */
+  int32_t ki; /* Output units per centi-Celsius per period, Q8 */
+  int32_t kd; /* Output units per centi-Celsius change per period, Q8 */
+  int32_t integral; /* Q8 */
+  int prev_error;
+  int out_min;
+  int out_max;
+};
+
+void pid_reset(struct pid* pid);
+int pid_update(struct pid* pid, int error);
+
+#endif /* __VEGIMETER2_PID_H */
@@ -0,0 +1,38 @@
+/*
+ * Vegimeter 2 phase profiler
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "prof.h"
+
+#ifdef VEGIMETER_PROFILE
+
+HUBDATA struct prof_mailbox prof_mailbox[PROF_NUM_PHASES];
+/* CNT at PROF_BEGIN(), only used by the cog of the phase. */
+HUBDATA uint32_t prof_start[PROF_NUM_PHASES];
+
+void prof_record(int8_t phase, uint32_t cycles) {
+  struct prof_mailbox* mb = &prof_mailbox[phase];
+  uint32_t v = cycles >> PROF_SHIFT;
+  int8_t b = 0;
+
+  /* floor(log2(cycles)) - PROF_SHIFT, clamped. No multiply or divide,
+   * they are library calls. */
+  while (v >>= 1) {
+    b++;
+  }
+  if (b >= PROF_BUCKETS) {
+    b = PROF_BUCKETS - 1;
+  }
+
+  mailbox_write_begin(mb);
+  mb->data.count[b]++;
+  if (cycles > mb->data.max) {
+    mb->data.max = cycles;
+  }
+  mailbox_write_end(mb);
+}
+
+#endif /* VEGIMETER_PROFILE */
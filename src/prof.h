@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_PROF_H
+#define __VEGIMETER2_PROF_H
+
+#include <stdint.h>
+#include "mailbox.h"
+
+/*
+ * Phase profiler. PROF_BEGIN() and PROF_END() around a phase time it with
+ * CNT, and the duration goes into the log2 histogram of the phase. The
+ * durations are unsigned differences, right across a CNT wrap as long as
+ * a phase is shorter than one (53 s at 80 MHz).
+ *
+ * Each phase is timed by one cog only. The telemetry cog sends the
+ * histograms in FRAME_PROFILE. Without VEGIMETER_PROFILE the macros are
+ * empty and the profiler takes no code and no hub RAM.
+ */
+
+/* The phases, each one in the cog that runs it. */
+#define PROF_CONTROL 0 /* Engine: control step */
+#define PROF_ACTUATORS 1 /* Engine: counters re-armed */
+#define PROF_CONVERT 2 /* Sensors: conversion started on all buses */
+#define PROF_READ 3 /* Sensors: every sensor read */
+#define PROF_REPORT 4 /* Telemetry: report frames built and appended */
+#define PROF_LEDS 5 /* Telemetry: LED animation step */
+#define PROF_XBEE_SEND 6 /* XBee: a packet shifted out */
+#define PROF_NUM_PHASES 7
+
+/*
+ * Bucket b counts the durations of 2^(PROF_SHIFT + b) cycles up to twice
+ * that, the first one also the shorter ones and the last one the longer
+ * ones. At 80 MHz the first one ends at 51 us and the last one starts at
+ * 839 ms.
+ */
+#define PROF_BUCKETS 16
+#define PROF_SHIFT 11
+
+struct prof_hist {
+  uint32_t max; /* Cycles, since boot */
+  uint32_t count[PROF_BUCKETS]; /* Since boot */
+};
+
+struct prof_mailbox {
+  volatile uint32_t seq;
+  struct prof_hist data;
+};
+
+#ifdef VEGIMETER_PROFILE
+
+extern struct prof_mailbox prof_mailbox[PROF_NUM_PHASES];
+extern uint32_t prof_start[PROF_NUM_PHASES];
+
+#define PROF_BEGIN(phase) (prof_start[(phase)] = CNT)
+#define PROF_END(phase) prof_record((phase), CNT - prof_start[(phase)])
+
+void prof_record(int8_t phase, uint32_t cycles);
+
+#else /* VEGIMETER_PROFILE */
+
+#define PROF_BEGIN(phase) do { } while (0)
+#define PROF_END(phase) do { } while (0)
+
+#endif /* VEGIMETER_PROFILE */
+
+#endif /* __VEGIMETER2_PROF_H */
@@ -14,13 +14,14 @@
  */
 
 #include <vegimeter.h>
+#include "serial.h"
 
 void pump_driver_runner(unsigned pump_on) {
   if (pump_on) {
     lh1500_on(14); /* Pump */
-    printf("  >>> Pump ON! <<<\n");
+    serial_puts(&serial_console, "  >>> Pump ON! <<<\n");
   } else {
     lh1500_off(14); /* Pump */
-    printf("  >>> Pump OFF! <<<\n");
+    serial_puts(&serial_console, "  >>> Pump OFF! <<<\n");
   }
 }
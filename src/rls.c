@@ -0,0 +1,116 @@
+/*
+ * Vegimeter 2 fixed-point recursive least squares
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "rls.h"
+
+void rls_init(struct rls* e) {
+  memset(e, 0, sizeof(*e));
+}
+
+static int64_t det3(int32_t m[RLS_N][RLS_N]) {
+  return m[0][0] * ((int64_t)m[1][1] * m[2][2] - (int64_t)m[1][2] * m[2][1]) -
+    m[0][1] * ((int64_t)m[1][0] * m[2][2] - (int64_t)m[1][2] * m[2][0]) +
+    m[0][2] * ((int64_t)m[1][0] * m[2][1] - (int64_t)m[1][1] * m[2][0]);
+}
+
+/*
+ * num / den in Q24, den > 0, by long division: the integer part, then one
+ * bit of the remainder at a time, which stays below 2 den and so in range.
+ * Returns 0 if the quotient does not fit in 32 bits.
+ */
+static int rls_div(int64_t num, int64_t den, int32_t* q) {
+  uint64_t n = num < 0 ? -(uint64_t)num : (uint64_t)num;
+  uint64_t quot = n / (uint64_t)den, rem = n % (uint64_t)den;
+  int8_t i;
+
+  if (quot >= (uint64_t)1 << (31 - RLS_Q)) {
+    return 0;
+  }
+  for (i = 0; i < RLS_Q; i++) {
+    rem <<= 1;
+    quot <<= 1;
+    if (rem >= (uint64_t)den) {
+      rem -= den;
+      quot |= 1;
+    }
+  }
+  *q = num < 0 ? -(int32_t)quot : (int32_t)quot;
+  return 1;
+}
+
+static void rls_solve(struct rls* e) {
+  int32_t m[RLS_N][RLS_N], v[RLS_N], col[RLS_N];
+  int32_t theta[RLS_N];
+  int64_t max = 0, a, det, diag;
+  int8_t i, j, shift = 0;
+
+  for (i = 0; i < RLS_N; i++) {
+    for (j = 0; j < RLS_N; j++) {
+      a = e->r[i][j] < 0 ? -e->r[i][j] : e->r[i][j];
+      max = a > max ? a : max;
+    }
+    a = e->xy[i] < 0 ? -e->xy[i] : e->xy[i];
+    max = a > max ? a : max;
+  }
+  while (max >> shift >= (int64_t)1 << RLS_SOLVE_BITS) {
+    shift++;
+  }
+  for (i = 0; i < RLS_N; i++) {
+    for (j = 0; j < RLS_N; j++) {
+      m[i][j] = e->r[i][j] >> shift;
+    }
+    v[i] = e->xy[i] >> shift;
+  }
+
+  /* The diagonal is at most 2^19, so are the products of up to three of
+   * them over 2^57, in range. The parameters are the minors over det to
+   * the full Q24, however small det. */
+  det = det3(m);
+  diag = (int64_t)m[0][0] * m[1][1] * m[2][2];
+  if (det <= 0 || det < diag >> RLS_COND_SHIFT) {
+    return;
+  }
+  for (i = 0; i < RLS_N; i++) {
+    for (j = 0; j < RLS_N; j++) {
+      col[j] = m[j][i];
+      m[j][i] = v[j];
+    }
+    if (!rls_div(det3(m), det, &theta[i])) {
+      return;
+    }
+    for (j = 0; j < RLS_N; j++) {
+      m[j][i] = col[j];
+    }
+  }
+  memcpy(e->theta, theta, sizeof(theta));
+  e->solved = 1;
+}
+
+void rls_update(struct rls* e, const int32_t* x, int32_t y) {
+  int8_t i, j;
+
+  for (i = 0; i < RLS_N; i++) {
+    for (j = 0; j < RLS_N; j++) {
+      e->r[i][j] += (int64_t)x[i] * x[j] - (e->r[i][j] >> RLS_FORGET_SHIFT);
+    }
+    e->xy[i] += (int64_t)x[i] * y - (e->xy[i] >> RLS_FORGET_SHIFT);
+  }
+  if (e->n < 0xFFFF) {
+    e->n++;
+  }
+  rls_solve(e);
+}
+
+int32_t rls_predict(const struct rls* e, const int32_t* x) {
+  int64_t y = 0;
+  int8_t i;
+
+  for (i = 0; i < RLS_N; i++) {
+    y += (int64_t)e->theta[i] * x[i];
+  }
+  return y >> RLS_Q;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_RLS_H
+#define __VEGIMETER2_RLS_H
+
+#include <stdint.h>
+
+/* Parameters of an estimator. */
+#define RLS_N 3
+/* The parameters are Q24 fixed point. */
+#define RLS_Q 24
+/* Forgetting factor 1 - 2^-RLS_FORGET_SHIFT, a memory of 128 samples. */
+#define RLS_FORGET_SHIFT 7
+/* The normal equations are scaled down to this many bits to be solved. */
+#define RLS_SOLVE_BITS 19
+/* The determinant must be at least 2^-RLS_COND_SHIFT of the product of the
+ * diagonal, or the regressors did not vary enough to tell the parameters
+ * apart. */
+#define RLS_COND_SHIFT 10
+
+/*
+ * Fixed-point recursive least squares with exponential forgetting, for
+ * y = theta . x. It keeps the normal equations, R = sum of x x^T and
+ * r = sum of x y, both decayed by the forgetting factor at each sample,
+ * and solves them by Cramer's rule after each update. The information form
+ * only adds integer products, so unlike the covariance form it cannot lose
+ * its positive definiteness to rounding. A solve only costs a few 64-bit
+ * multiplications, and the estimator is updated every few minutes.
+ *
+ * theta keeps the last solution that was well conditioned.
+ */
+struct rls {
+  int64_t r[RLS_N][RLS_N];
+  int64_t xy[RLS_N];
+  int32_t theta[RLS_N]; /* Q24 */
+  uint16_t n; /* Samples, saturated */
+  int8_t solved; /* theta was solved at least once */
+};
+
+void rls_init(struct rls* e);
+void rls_update(struct rls* e, const int32_t* x, int32_t y);
+/* theta . x, in the units of y. */
+int32_t rls_predict(const struct rls* e, const int32_t* x);
+
+#endif /* __VEGIMETER2_RLS_H */
@@ -0,0 +1,94 @@
+/*
+ * Vegimeter 2 deadline scheduler
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "idle.h"
+#include "sched.h"
+
+/* Extends CNT, the scheduler must look at least once per CNT wrap. */
+static void sched_clock(struct sched* s) {
+  uint32_t cnt = CNT;
+
+  s->now += (uint32_t)(cnt - s->cnt);
+  s->cnt = cnt;
+}
+
+void sched_init(struct sched* s, struct sched_task* tasks, int8_t num_tasks,
+                int8_t cog) {
+  int8_t i;
+
+  s->tasks = tasks;
+  s->num_tasks = num_tasks;
+  s->cog = cog;
+  s->cnt = CNT;
+  s->now = 0;
+  for (i = 0; i < num_tasks; i++) {
+    tasks[i].next = (uint64_t)tasks[i].phase * (CLKFREQ / 1000);
+    tasks[i].runs = 0;
+    tasks[i].late = tasks[i].late_max = 0;
+    tasks[i].overruns = 0;
+  }
+}
+
+static void sched_run_task(struct sched* s, struct sched_task* t) {
+  uint64_t late = s->now - t->next;
+  uint64_t period = (uint64_t)t->period * (CLKFREQ / 1000);
+  unsigned int ms;
+
+  t->late = late > 0xFFFFFFFFU ? 0xFFFFFFFFU : (uint32_t)late;
+  if (t->late > t->late_max) {
+    t->late_max = t->late;
+  }
+  t->runs++;
+  ms = t->run();
+  sched_clock(s);
+  if (ms) {
+    t->next = s->now + (uint64_t)ms * (CLKFREQ / 1000);
+    return;
+  }
+  t->next += period;
+  while (t->next <= s->now) {
+    t->next += period;
+    t->overruns++;
+  }
+}
+
+uint32_t sched_poll(struct sched* s) {
+  uint64_t next, max = (uint64_t)IDLE_MAX_MS * (CLKFREQ / 1000);
+  int8_t i;
+
+  for (i = 0; i < s->num_tasks; i++) {
+    sched_clock(s);
+    if (s->tasks[i].next <= s->now) {
+      sched_run_task(s, &s->tasks[i]);
+    }
+  }
+
+  sched_clock(s);
+  next = s->now + max;
+  for (i = 0; i < s->num_tasks; i++) {
+    if (s->tasks[i].next < next) {
+      next = s->tasks[i].next;
+    }
+  }
+  return next > s->now ? (uint32_t)(next - s->now) : 0;
+}
+
+void sched_wake(struct sched* s, struct sched_task* t) {
+  sched_clock(s);
+  t->next = s->now;
+}
+
+void sched_wake_in(struct sched* s, struct sched_task* t, unsigned int ms) {
+  sched_clock(s);
+  t->next = s->now + (uint64_t)ms * (CLKFREQ / 1000);
+}
+
+void sched_run(struct sched* s) {
+  while (1) {
+    idle_until(s->cog, CNT + sched_poll(s));
+  }
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_SCHED_H
+#define __VEGIMETER2_SCHED_H
+
+#include <stdint.h>
+
+/*
+ * Multi-rate deadline scheduler, one per cog.
+ *
+ * Deadlines are absolute: a task that keeps its period is due period
+ * milliseconds after its previous deadline, not after it ran, so the work
+ * time does not add up. The scheduler extends CNT to a 64-bit clock every
+ * time it polls, which it does at least every IDLE_MAX_MS, so periods may
+ * be longer than a CNT wrap.
+ *
+ * A task's run() returns 0 to keep its period, or the milliseconds until
+ * it wants to run again. Late starts are recorded as jitter; deadlines
+ * that passed while the task was still running are skipped and counted as
+ * overruns. Tasks that are due together run in table order.
+ */
+struct sched_task {
+  unsigned int (*run)();
+  unsigned int period; /* Milliseconds */
+  unsigned int phase; /* Milliseconds, first deadline after sched_init() */
+  uint64_t next; /* Deadline on the scheduler clock, cycles */
+  uint32_t runs;
+  uint32_t late; /* Cycles the last run started late */
+  uint32_t late_max; /* Cycles */
+  uint16_t overruns;
+};
+
+struct sched {
+  struct sched_task* tasks;
+  int8_t num_tasks;
+  int8_t cog; /* Idle account */
+  uint32_t cnt; /* CNT at the last clock update */
+  uint64_t now; /* Cycles since sched_init() */
+};
+
+/* The tasks are first due at their phase. */
+void sched_init(struct sched* s, struct sched_task* tasks, int8_t num_tasks,
+                int8_t cog);
+/* Runs the due tasks. Returns the cycles until the next deadline, at most
+ * IDLE_MAX_MS worth. */
+uint32_t sched_poll(struct sched* s);
+/* Makes the task due now, it runs in the same or the next poll. */
+void sched_wake(struct sched* s, struct sched_task* t);
+/* Makes the task due in ms milliseconds, instead of its next deadline. */
+void sched_wake_in(struct sched* s, struct sched_task* t, unsigned int ms);
+/* Polls and sleeps in between, forever. */
+void sched_run(struct sched* s);
+
+#endif /* __VEGIMETER2_SCHED_H */
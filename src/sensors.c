@@ -0,0 +1,483 @@
+/*
+ * Vegimeter 2 DS18B20 sensors acquisition
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "engine.h"
+#include "idle.h"
+#include "mailbox.h"
+#include "onewire_cog.h"
+#include "prof.h"
+#include "sched.h"
+#include "sensors.h"
+#include "stats.h"
+
+/* The configured sensors, indexed by role. */
+HUBDATA const struct sensor_config sensor_config[NUM_SENSORS] = SENSOR_CONFIG;
+/*
+ * Sensor table. The first NUM_SENSORS entries are loaded from sensor_config
+ * by sensors_init(), the unassigned sensors found on the buses follow.
+ */
+HUBDATA struct sensor sensors[MAX_SENSORS];
+HUBDATA int8_t num_sensors = 0;
+HUBDATA int16_t bus_pins[MAX_BUSES];
+HUBDATA int8_t num_buses = 0;
+/* Bus status, SENSOR_CONVERTING while a conversion is in progress. */
+HUBDATA static int8_t bus_status[MAX_BUSES];
+/* Number of DS18B20 found on each bus by the last discovery. */
+HUBDATA static int8_t bus_devices[MAX_BUSES];
+HUBDATA struct sensors_mailbox sensors_mailbox;
+HUBDATA static int8_t num_found = 0;
+HUBDATA static uint8_t found_roms[MAX_SENSORS][OW_ROM_SIZE];
+HUBDATA uint32_t sensors_conversion_ms = 0;
+/* Coprocessor requests, one per bus at a time. */
+HUBDATA static struct ow_request sensors_requests[MAX_BUSES];
+
+/* Stages of a sensor within sensors_read_all(). */
+#define STAGE_DONE 0
+#define STAGE_FAST 1 /* Temperature bytes only */
+#define STAGE_FULL 2 /* Scratch pad and CRC */
+#define STAGE_CONFIG 3 /* Write the resolution */
+
+HUBDATA static int8_t read_stage[MAX_SENSORS];
+HUBDATA static int8_t read_tries[MAX_SENSORS];
+HUBDATA static int8_t read_want[MAX_SENSORS]; /* Resolution */
+/* Sensing periods since boot, for the sensors sampled less often. */
+HUBDATA static uint32_t sensors_period = 0;
+HUBDATA struct sched sensors_sched;
+/* One conversion window for all the sensors, the cog sleeps through it. */
+HUBDATA static struct sched_task sensors_tasks[SENSORS_NUM_TASKS] = {
+  { sensors_convert, SENSING_PERIOD, 0 },
+  { sensors_step, SENSING_PERIOD, DS18B20_CONVERSION_TIME_MS },
+};
+/* The threshold each kind is compared with, for the resolution policy. */
+HUBDATA static const int16_t sensors_threshold[SENSOR_NUM_KINDS] = {
+  MAX_AIR_TEMP, SOIL_SETPOINT, SOIL_SETPOINT + PUMP_MIN_GAIN,
+};
+
+/* The reading is a two's complement in 1/16 C. */
+static int16_t ds18b20_raw(uint8_t lsb, uint8_t msb, int8_t res) {
+  int16_t raw = (int16_t)((msb << 8) | lsb);
+
+  /* The low bits below the resolution are undefined. */
+  return raw & ~((1 << (12 - res)) - 1);
+}
+
+static int ds18b20_to_centi_celsius(int16_t raw) {
+  return DS18B20_1_100TH_CELCIUS(raw) / 16;
+}
+
+/* Calibrated reading of the sensor, centi-Celsius. */
+static int sensors_temp(struct sensor* s, int16_t raw) {
+  return ds18b20_to_centi_celsius(raw) + s->offset;
+}
+
+/* Whether the sensor is sampled in this sensing period. */
+static int8_t sensors_due(struct sensor* s) {
+  return s->every <= 1 || sensors_period % s->every == 0;
+}
+
+static void sensors_load(struct sensor* s, int16_t pin, const uint8_t* rom) {
+  s->pin = pin;
+  s->offset = 0;
+  s->every = 1;
+  s->bus = -1;
+  s->status = SENSOR_NO_PRESENCE;
+  s->temp = DEFAULT_TEMP_READING;
+  s->resolution = 0;
+  s->fast_reads = s->lost = 0;
+  s->errors = s->failures = 0;
+  memcpy(s->rom, rom, OW_ROM_SIZE);
+}
+
+static int8_t sensors_bind_bus(struct sensor* s) {
+  int8_t b;
+
+  for (b = 0; b < num_buses; b++) {
+    if (bus_pins[b] == s->pin) {
+      return s->bus = b;
+    }
+  }
+  if (num_buses == MAX_BUSES) {
+    return s->bus = -1;
+  }
+  bus_pins[num_buses] = s->pin;
+  return s->bus = num_buses++;
+}
+
+static struct sensor* sensors_find(int16_t pin, const uint8_t* rom,
+                                   int8_t alone) {
+  struct sensor* s;
+
+  for (s = sensors; s < sensors + num_sensors; s++) {
+    if (s->pin != pin) {
+      continue;
+    }
+    if (!memcmp(s->rom, rom, OW_ROM_SIZE)) {
+      return s;
+    }
+    if (alone && ow_rom_is_null(s->rom)) {
+      memcpy(s->rom, rom, OW_ROM_SIZE);
+      return s;
+    }
+  }
+  return NULL;
+}
+
+int8_t sensors_discover() {
+  struct ow_request* r = &sensors_requests[0];
+  struct sensor* s;
+  int8_t b, i, n, found = 0;
+
+  num_buses = 0;
+  for (s = sensors; s < sensors + num_sensors; s++) {
+    sensors_bind_bus(s);
+  }
+  for (b = 0; b < num_buses; b++) {
+    r->op = OW_OP_SEARCH;
+    r->pin = bus_pins[b];
+    r->roms = found_roms;
+    r->max_roms = MAX_SENSORS;
+    ow_submit(r);
+    ow_wait(r);
+    n = r->num_roms;
+    bus_devices[b] = 0;
+    for (i = 0; i < n; i++) {
+      if (OW_ROM_FAMILY(found_roms[i]) != DS18B20_FAMILY_CODE) {
+        continue;
+      }
+      found++;
+      bus_devices[b]++;
+      if (sensors_find(bus_pins[b], found_roms[i], n == 1)) {
+        continue;
+      }
+      if (num_sensors == MAX_SENSORS) {
+        continue;
+      }
+      s = &sensors[num_sensors++];
+      sensors_load(s, bus_pins[b], found_roms[i]);
+      s->bus = b;
+    }
+  }
+  return found;
+}
+
+unsigned int sensors_start_conversion() {
+  struct ow_request* r;
+  struct sensor* s;
+  int8_t b, res = 0;
+
+  /* All the slaves on each bus convert at once, all the buses together. */
+  for (b = 0; b < num_buses; b++) {
+    r = &sensors_requests[b];
+    r->op = OW_OP_TRANSACTION;
+    r->pin = bus_pins[b];
+    r->flags = OW_SKIP;
+    r->command = DS18B20_CONVERT_TEMPERATURE;
+    r->num_write = r->num_read = 0;
+    ow_submit(r);
+  }
+  for (b = 0; b < num_buses; b++) {
+    bus_status[b] = ow_wait(&sensors_requests[b]) == OW_DONE ?
+        SENSOR_CONVERTING : SENSOR_NO_PRESENCE;
+  }
+
+  /* The slowest sensor on a converting bus sets the window. */
+  for (s = sensors; s < sensors + num_sensors; s++) {
+    if (s->bus < 0 || bus_status[s->bus] != SENSOR_CONVERTING ||
+        !sensors_due(s)) {
+      continue;
+    }
+    if (s->resolution == 0) {
+      /* Not read yet, the power-on default. */
+      res = DS18B20_MAX_RESOLUTION;
+      break;
+    }
+    if (s->resolution > res) {
+      res = s->resolution;
+    }
+  }
+  return res ? DS18B20_CONVERSION_TIME(res) : 0;
+}
+
+/* Picks the resolution of the next reading of the sensor. */
+static int8_t sensors_resolution(struct sensor* s) {
+  int8_t role = s - sensors;
+  struct stats_summary summary;
+  int margin, step;
+  int8_t res;
+
+  if (role >= NUM_SENSORS) {
+    return DS18B20_MIN_RESOLUTION;
+  }
+  if (s->status != SENSOR_OK || s->temp == DEFAULT_TEMP_READING) {
+    return DS18B20_MAX_RESOLUTION;
+  }
+  margin = s->temp - sensors_threshold[sensor_config[role].kind];
+  if (margin < 0) {
+    margin = -margin;
+  }
+  stats_summary(role, STATS_WINDOW_SHORT, &summary);
+  if (summary.n > 1) {
+    margin -= (summary.slope < 0 ? -summary.slope : summary.slope) *
+              SENSORS_RES_HORIZON / 60;
+  }
+  /* 6.25 centi-Celsius steps at 12 bits, 50 at 9 bits. */
+  for (res = DS18B20_MIN_RESOLUTION; res < DS18B20_MAX_RESOLUTION; res++) {
+    step = 625 << (12 - res);
+    if (SENSORS_RES_STEPS * step <= 100 * margin) {
+      break;
+    }
+  }
+  return res;
+}
+
+/*
+ * Fast path, only the two temperature bytes. The DS18B20 stops sending at
+ * the next bus reset. There is no CRC to check, so the reading is only
+ * taken if it looks like the previous one.
+ */
+static int8_t sensors_check_fast(struct sensor* s, const uint8_t* sp,
+                                 int16_t* raw) {
+  int temp;
+
+  if ((sp[0] == 0xFF && sp[1] == 0xFF) ||
+      (sp[0] == DS18B20_POWER_ON_LSB && sp[1] == DS18B20_POWER_ON_MSB)) {
+    /* Nobody talking, or a slave that reset and did not convert. */
+    return -1;
+  }
+  *raw = ds18b20_raw(sp[0], sp[1], s->resolution);
+  temp = sensors_temp(s, *raw);
+  if (*raw < DS18B20_RAW_MIN || *raw > DS18B20_RAW_MAX ||
+      temp - s->temp > SENSORS_MAX_STEP || s->temp - temp > SENSORS_MAX_STEP) {
+    return -1;
+  }
+  return 0;
+}
+
+static void sensors_fail(struct sensor* s) {
+  if (s->failures < 0xFFFF) {
+    s->failures++;
+  }
+  /* The last reading stands in for a few lost samples, the engine halts
+   * on DEFAULT_TEMP_READING. */
+  if (s->lost < SENSORS_MAX_LOST) {
+    s->lost++;
+  } else {
+    s->temp = DEFAULT_TEMP_READING;
+  }
+  s->status = SENSOR_READ_FAILED;
+}
+
+/* The coprocessor request for the current stage of the sensor. */
+static void sensors_request(struct sensor* s, struct ow_request* r) {
+  int8_t i = s - sensors;
+
+  r->op = OW_OP_TRANSACTION;
+  r->pin = s->pin;
+  r->flags = ow_rom_is_null(s->rom) ? OW_SKIP : 0;
+  memcpy(r->rom, s->rom, OW_ROM_SIZE);
+  r->num_write = r->num_read = 0;
+  switch (read_stage[i]) {
+  case STAGE_FAST:
+    r->command = DS18B20_READ_SCRATCHPAD;
+    r->num_read = 2;
+    break;
+  case STAGE_FULL:
+    r->command = DS18B20_READ_SCRATCHPAD;
+    r->num_read = DS18B20_SCRATCHPAD_SIZE;
+    break;
+  case STAGE_CONFIG:
+    /* Only to the scratch pad, not to the EEPROM of the DS18B20, so it
+     * wears nothing. TH and TL are kept. */
+    r->command = DS18B20_WRITE_SCRATCHPAD;
+    r->num_write = 3;
+    r->data[0] = s->alarm[0];
+    r->data[1] = s->alarm[1];
+    r->data[2] = DS18B20_CONFIG(read_want[i]);
+    break;
+  }
+}
+
+/* Takes the answer to sensors_request() and moves on to the next stage. */
+static void sensors_answer(struct sensor* s, struct ow_request* r) {
+  int8_t i = s - sensors;
+  uint8_t* sp = r->data;
+  int16_t raw;
+
+  switch (read_stage[i]) {
+  case STAGE_FAST:
+    /* s->temp is still the previous reading. */
+    if (r->status == OW_DONE && !sensors_check_fast(s, sp, &raw)) {
+      s->temp = sensors_temp(s, raw);
+      s->fast_reads++;
+      read_stage[i] = STAGE_DONE;
+      return;
+    }
+    read_stage[i] = STAGE_FULL;
+    return;
+  case STAGE_FULL:
+    if (r->status != OW_DONE || ow_crc8(sp, DS18B20_SCRATCHPAD_SIZE - 1) !=
+        sp[DS18B20_SCRATCHPAD_SIZE - 1]) {
+      if (s->errors < 0xFFFF) {
+        s->errors++;
+      }
+      if (++read_tries[i] > SENSORS_READ_RETRIES) {
+        sensors_fail(s);
+        read_stage[i] = STAGE_DONE;
+      }
+      return;
+    }
+    if (sp[0] == DS18B20_POWER_ON_LSB && sp[1] == DS18B20_POWER_ON_MSB) {
+      /* A slave that reset, back to its power-on resolution too. */
+      s->resolution = 0;
+      sensors_fail(s);
+      read_stage[i] = STAGE_DONE;
+      return;
+    }
+    s->resolution = DS18B20_CONFIG_RESOLUTION(sp[DS18B20_SP_CONFIG]);
+    s->temp = sensors_temp(s, ds18b20_raw(sp[0], sp[1], s->resolution));
+    s->alarm[0] = sp[DS18B20_SP_TH];
+    s->alarm[1] = sp[DS18B20_SP_TL];
+    s->status = SENSOR_OK;
+    s->fast_reads = 0;
+    s->lost = 0;
+    read_want[i] = sensors_resolution(s);
+    read_stage[i] = read_want[i] != s->resolution ? STAGE_CONFIG : STAGE_DONE;
+    return;
+  case STAGE_CONFIG:
+    if (r->status == OW_DONE) {
+      /* The conversion window goes by the new resolution from now on. */
+      s->resolution = read_want[i];
+    }
+    read_stage[i] = STAGE_DONE;
+    return;
+  }
+}
+
+void sensors_read_all() {
+  struct sensor* batch[MAX_BUSES];
+  struct sensor* s;
+  int8_t b, i, n;
+
+  for (s = sensors; s < sensors + num_sensors; s++) {
+    i = s - sensors;
+    read_tries[i] = 0;
+    if (!sensors_due(s)) {
+      read_stage[i] = STAGE_DONE;
+    } else if (s->bus < 0 || bus_status[s->bus] != SENSOR_CONVERTING) {
+      s->temp = DEFAULT_TEMP_READING;
+      s->status = SENSOR_NO_PRESENCE;
+      read_stage[i] = STAGE_DONE;
+    } else if (ow_rom_is_null(s->rom) && bus_devices[s->bus] > 1) {
+      /* SKIP ROM would make all the slaves answer at once. */
+      sensors_fail(s);
+      read_stage[i] = STAGE_DONE;
+    } else if (s->status == SENSOR_OK && s->resolution &&
+               s->fast_reads < SENSORS_FAST_READS) {
+      read_stage[i] = STAGE_FAST;
+    } else {
+      read_stage[i] = STAGE_FULL;
+    }
+  }
+
+  /* Rounds of one request per bus, the coprocessor runs them in lockstep. */
+  do {
+    n = 0;
+    for (b = 0; b < num_buses; b++) {
+      batch[b] = NULL;
+      for (s = sensors; s < sensors + num_sensors; s++) {
+        if (s->bus == b && read_stage[s - sensors] != STAGE_DONE) {
+          batch[b] = s;
+          sensors_request(s, &sensors_requests[b]);
+          ow_submit(&sensors_requests[b]);
+          n++;
+          break;
+        }
+      }
+    }
+    for (b = 0; b < num_buses; b++) {
+      if (batch[b]) {
+        ow_wait(&sensors_requests[b]);
+        sensors_answer(batch[b], &sensors_requests[b]);
+      }
+    }
+  } while (n > 0);
+}
+
+int sensors_get_temp(int8_t role) {
+  return sensors[role].temp;
+}
+
+static void sensors_update_stats() {
+  int8_t i;
+
+  mailbox_write_begin(&stats_mailbox);
+  for (i = 0; i < NUM_SENSORS; i++) {
+    if (sensors_due(&sensors[i]) && sensors[i].status == SENSOR_OK &&
+        sensors[i].temp != DEFAULT_TEMP_READING) {
+      stats_push(i, sensors[i].temp);
+    }
+  }
+  mailbox_write_end(&stats_mailbox);
+}
+
+static void sensors_publish() {
+  int8_t i;
+
+  mailbox_write_begin(&sensors_mailbox);
+  sensors_mailbox.data.num_sensors = num_sensors;
+  sensors_mailbox.data.num_found = num_found;
+  for (i = 0; i < num_sensors; i++) {
+    sensors_mailbox.data.status[i] = sensors[i].status;
+    sensors_mailbox.data.temp[i] = sensors[i].temp;
+    sensors_mailbox.data.errors[i] = sensors[i].errors;
+    sensors_mailbox.data.failures[i] = sensors[i].failures;
+  }
+  mailbox_write_end(&sensors_mailbox);
+}
+
+void sensors_init() {
+  const struct sensor_config* c;
+  struct sensor* s;
+
+  for (num_sensors = 0; num_sensors < NUM_SENSORS; num_sensors++) {
+    c = &sensor_config[num_sensors];
+    s = &sensors[num_sensors];
+    sensors_load(s, c->pin, c->rom);
+    s->offset = c->offset;
+    s->every = c->every;
+  }
+  num_found = sensors_discover();
+  stats_init();
+  sched_init(&sensors_sched, sensors_tasks, SENSORS_NUM_TASKS,
+             IDLE_SENSORS);
+}
+
+unsigned int sensors_convert() {
+  unsigned int ms;
+
+  PROF_BEGIN(PROF_CONVERT);
+  ms = sensors_start_conversion();
+  PROF_END(PROF_CONVERT);
+  sensors_conversion_ms += ms;
+  sched_wake_in(&sensors_sched, &sensors_tasks[SENSORS_TASK_READ], ms);
+  return 0;
+}
+
+unsigned int sensors_step() {
+  PROF_BEGIN(PROF_READ);
+  sensors_read_all();
+  PROF_END(PROF_READ);
+  sensors_update_stats();
+  sensors_publish();
+  sensors_period++;
+  return 0;
+}
+
+void sensors_runner(void* par) {
+  sensors_init();
+  sched_run(&sensors_sched);
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_SENSORS_H
+#define __VEGIMETER2_SENSORS_H
+
+#include <stdint.h>
+#include "onewire_rom.h"
+#include "sched.h"
+/* Sensor roles and table, generated from the mapping (vegimeter2.py). */
+#include "vegimeter2_tables.h"
+
+/* Read scratch pad. */
+#define DS18B20_READ_SCRATCHPAD 0xBE
+/* Write scratch pad. */
+#define DS18B20_WRITE_SCRATCHPAD 0x4E
+/* Start temperature conversion. */
+#define DS18B20_CONVERT_TEMPERATURE 0x44
+/* Read power status. */
+#define DS18B20_READ_POWER 0xB4
+/* Scratch pad size in bytes. */
+#define DS18B20_SCRATCHPAD_SIZE 9
+/* Scratch pad bytes. */
+#define DS18B20_SP_TH 2
+#define DS18B20_SP_TL 3
+#define DS18B20_SP_CONFIG 4
+/* Reading until the first conversion, 85 C. */
+#define DS18B20_POWER_ON_LSB 0x50
+#define DS18B20_POWER_ON_MSB 0x05
+/* Measurement range, -55 C to +125 C in 1/16 C. */
+#define DS18B20_RAW_MIN (-55 * 16)
+#define DS18B20_RAW_MAX (125 * 16)
+/* Worst case conversion time at the default 12-bit resolution. */
+#define DS18B20_CONVERSION_TIME_MS 750
+
+/*
+ * Resolution, 9 to 12 bits. Each bit less halves the conversion time,
+ * from 750 ms down to 93.75 ms, and doubles the step from 1/16 C up to
+ * 1/2 C. The undefined low bits of the reading must be dropped.
+ */
+#define DS18B20_MIN_RESOLUTION 9
+#define DS18B20_MAX_RESOLUTION 12
+#define DS18B20_CONFIG(res) ((((res) - 9) << 5) | 0x1F)
+#define DS18B20_CONFIG_RESOLUTION(config) (9 + (((config) >> 5) & 3))
+/* Rounded up, milliseconds. */
+#define DS18B20_CONVERSION_TIME(res) \
+  ((DS18B20_CONVERSION_TIME_MS >> (12 - (res))) + 1)
+
+/*
+ * Resolution policy: a sensor runs at the coarsest resolution whose step
+ * is at most 1/SENSORS_RES_STEPS of the distance between its reading and
+ * the threshold it is compared with, less how far it moves at its current
+ * rate in SENSORS_RES_HORIZON. So the probes that are far from any
+ * decision and slow are sampled coarse and fast, and the ones close to the
+ * band precisely. Unassigned sensors always run at 9 bits.
+ */
+#define SENSORS_RES_STEPS 8
+#define SENSORS_RES_HORIZON 10 // Minutes
+
+/*
+ * Reading policy. A healthy sensor is read with only the two temperature
+ * bytes, a quarter of the scratch pad. Every SENSORS_FAST_READS readings,
+ * after a failure and whenever a short read looks wrong (no answer, the
+ * power-on value, out of range or more than SENSORS_MAX_STEP away from the
+ * previous reading) the whole scratch pad is read and checked with its
+ * CRC, up to SENSORS_READ_RETRIES more times. Only then is the sample
+ * lost. A scratch pad with a good CRC that holds the power-on value is
+ * lost at once: the slave reset since the conversion, it converts again
+ * with the next sample. The previous reading stands in for up to SENSORS_MAX_LOST lost
+ * samples in a row (with SENSOR_READ_FAILED) before the sensor reads as
+ * DEFAULT_TEMP_READING.
+ */
+#define SENSORS_FAST_READS 11
+#define SENSORS_MAX_STEP 200 // Centi-Celsius per SENSING_PERIOD
+#define SENSORS_READ_RETRIES 2
+#define SENSORS_MAX_LOST 2
+
+/* The sensing cog samples the unit this often. */
+#define SENSING_PERIOD 5000 // Milliseconds
+
+#define DEFAULT_TEMP_READING 54321
+#define DS18B20_1_100TH_CELCIUS(value) (100 * (value))
+
+/* What a sensor measures. */
+#define SENSOR_KIND_AIR 0
+#define SENSOR_KIND_SOIL 1
+#define SENSOR_KIND_WATER 2
+#define SENSOR_NUM_KINDS 3
+/* Configured sensors plus the unassigned ones found on the buses. */
+#define MAX_SENSORS 32
+/* Max number of distinct 1-Wire bus pins. */
+#define MAX_BUSES 8
+
+/* Per sensor acquisition status. */
+#define SENSOR_OK 0
+#define SENSOR_NO_PRESENCE 1 /* Bus reset failed or the bus is not idle */
+#define SENSOR_CONVERTING 2
+#define SENSOR_READ_FAILED 3
+
+/*
+ * A configured sensor, one per role. A null ROM ID means the sensor is the
+ * only slave on its pin and is addressed with SKIP ROM. Otherwise it is
+ * addressed with MATCH ROM.
+ */
+struct sensor_config {
+  int8_t pin;
+  int8_t kind; /* SENSOR_KIND_* */
+  int16_t offset; /* Centi-Celsius added to the readings */
+  uint8_t every; /* Sampled every so many SENSING_PERIOD */
+  uint8_t rom[OW_ROM_SIZE];
+};
+
+struct sensor {
+  int16_t pin;
+  int16_t offset; /* Centi-Celsius */
+  uint8_t every; /* SENSING_PERIOD */
+  int8_t bus; /* Index into bus_pins */
+  int8_t status;
+  int temp; /* Centi-Celsius or DEFAULT_TEMP_READING */
+  int8_t resolution; /* Bits of the last reading, 0 if unknown */
+  int8_t fast_reads; /* Since the last full read */
+  int8_t lost; /* Samples lost in a row */
+  uint16_t errors; /* Full reads that failed, saturated */
+  uint16_t failures; /* Samples lost after the retries, saturated */
+  uint8_t alarm[2]; /* TH and TL, written back with the configuration */
+  uint8_t rom[OW_ROM_SIZE];
+};
+
+/* Published by the sensing cog after every acquisition. */
+struct sensors_snapshot {
+  int8_t num_sensors;
+  int8_t num_found; /* DS18B20 found by the boot time discovery */
+  int8_t status[MAX_SENSORS];
+  int temp[MAX_SENSORS];
+  uint16_t errors[MAX_SENSORS];
+  uint16_t failures[MAX_SENSORS];
+};
+
+struct sensors_mailbox {
+  volatile uint32_t seq;
+  struct sensors_snapshot data;
+};
+
+extern struct sensors_mailbox sensors_mailbox;
+extern const struct sensor_config sensor_config[NUM_SENSORS];
+extern struct sensor sensors[MAX_SENSORS];
+extern int8_t num_sensors;
+extern int16_t bus_pins[MAX_BUSES];
+extern int8_t num_buses;
+/* Time spent waiting for conversions since boot. */
+extern uint32_t sensors_conversion_ms;
+
+/*
+ * Enumerates every bus with SEARCH ROM and caches the ROM IDs in the sensor
+ * table. A slave that is alone on the pin of a configured sensor without
+ * ROM ID is bound to that sensor. Slaves that match no configured sensor are
+ * appended after the configured ones. Returns the number of DS18B20 found.
+ */
+int8_t sensors_discover();
+/*
+ * Samples every sensor in three passes: broadcast a conversion on every
+ * bus with SKIP ROM, wait out a single conversion window, then read all
+ * the scratch pads with MATCH ROM. The time to sample the whole unit is
+ * about one conversion time of the finest resolution in use, regardless
+ * of the number of sensors. sensors_start_conversion() returns that time
+ * in milliseconds. sensors_read_all() also applies the resolution policy
+ * for the next conversion. A sensor that is not due in this period, as
+ * set by its every, keeps its previous reading and status.
+ *
+ * The bus work is done by the 1-Wire coprocessor (see onewire_cog.h), one
+ * request per bus at a time so that the buses run in lockstep.
+ */
+unsigned int sensors_start_conversion();
+void sensors_read_all();
+int sensors_get_temp(int8_t role);
+/*
+ * Sensing cog: loads the sensor table and discovers the sensors with
+ * sensors_init(), then every
+ * SENSING_PERIOD the sensors_convert() task starts the conversions and
+ * wakes the sensors_step() task to read and publish them a conversion
+ * time later.
+ */
+#define SENSORS_TASK_CONVERT 0
+#define SENSORS_TASK_READ 1
+#define SENSORS_NUM_TASKS 2
+
+extern struct sched sensors_sched;
+
+void sensors_init();
+unsigned int sensors_convert();
+unsigned int sensors_step();
+void sensors_runner(void* par);
+
+#endif /* __VEGIMETER2_SENSORS_H */
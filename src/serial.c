@@ -0,0 +1,83 @@
+/*
+ * Vegimeter 2 software serial port
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "pins.h"
+#include "serial.h"
+
+HUBDATA struct serial serial_console;
+
+void serial_open(struct serial* s, int8_t tx_pin, int8_t rx_pin,
+                 unsigned int baudrate) {
+  s->tx_mask = tx_pin == SERIAL_NO_PIN ? 0 : GET_MASK(tx_pin);
+  s->rx_mask = rx_pin == SERIAL_NO_PIN ? 0 : GET_MASK(rx_pin);
+  s->bit = CLKFREQ / baudrate;
+  /* Idle high. */
+  OUT_HIGH_MASK(s->tx_mask);
+  DIR_OUTPUT_MASK(s->tx_mask);
+  DIR_INPUT_MASK(s->rx_mask);
+}
+
+void serial_console_open() {
+  serial_open(&serial_console, SERIAL_CONSOLE_TX_PIN, SERIAL_CONSOLE_RX_PIN,
+              SERIAL_CONSOLE_BAUDRATE);
+}
+
+void serial_putc(struct serial* s, uint8_t c) {
+  /* Start bit, the data LSB first, then the stop bit. */
+  uint16_t bits = (c | 0x100) << 1;
+  unsigned int t = CNT;
+  int8_t i;
+
+  for (i = 0; i < 10; i++) {
+    if (bits & 1) {
+      OUT_HIGH_MASK(s->tx_mask);
+    } else {
+      OUT_LOW_MASK(s->tx_mask);
+    }
+    bits >>= 1;
+    t += s->bit;
+    waitcnt(t);
+  }
+}
+
+void serial_write(struct serial* s, const void* data, uint16_t size) {
+  const uint8_t* p = data;
+
+  while (size--) {
+    serial_putc(s, *p++);
+  }
+}
+
+void serial_puts(struct serial* s, const char* str) {
+  while (*str) {
+    serial_putc(s, *str++);
+  }
+}
+
+#ifndef VEGIMETER_HOST
+int serial_getc(struct serial* s) {
+  unsigned int t;
+  uint8_t c = 0;
+  int8_t i;
+
+  /* Idle high, the cog sleeps until the start bit. */
+  waitpeq(s->rx_mask, s->rx_mask);
+  waitpeq(0, s->rx_mask);
+  t = CNT + s->bit + s->bit / 2;
+  for (i = 0; i < 8; i++) {
+    t = waitcnt2(t, s->bit);
+    c = (c >> 1) | ((INA & s->rx_mask) ? 0x80 : 0);
+  }
+  waitcnt(t);
+  return (INA & s->rx_mask) ? c : -1;
+}
+#else
+/* The simulator hands the received bytes to xbee_rx_put() itself. */
+int serial_getc(struct serial* s) {
+  return -1;
+}
+#endif
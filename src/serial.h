@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_SERIAL_H
+#define __VEGIMETER2_SERIAL_H
+
+#include <stdint.h>
+
+/*
+ * Serial port in software, 8N1, without stdio: no FILE, no driver list, no
+ * heap. Each byte is timed with waitcnt() by the cog that sends or receives
+ * it, so a port belongs to one cog. DIRA is per cog, serial_open() must be
+ * called by the cog that transmits.
+ */
+
+/* The Prop Plug, what propeller-load's terminal listens to. */
+#define SERIAL_CONSOLE_TX_PIN 30
+#define SERIAL_CONSOLE_RX_PIN 31
+#define SERIAL_CONSOLE_BAUDRATE 115200
+
+/* No pin, for a port that only sends or only receives. */
+#define SERIAL_NO_PIN -1
+
+struct serial {
+  uint32_t tx_mask;
+  uint32_t rx_mask;
+  unsigned int bit; /* Clock ticks per bit */
+};
+
+extern struct serial serial_console;
+
+void serial_open(struct serial* s, int8_t tx_pin, int8_t rx_pin,
+                 unsigned int baudrate);
+void serial_console_open();
+void serial_putc(struct serial* s, uint8_t c);
+void serial_write(struct serial* s, const void* data, uint16_t size);
+void serial_puts(struct serial* s, const char* str);
+/*
+ * Sleeps in waitpeq() until a byte comes and returns it, or -1 on a
+ * framing error. The caller resynchronizes by calling it again.
+ */
+int serial_getc(struct serial* s);
+
+#endif /* __VEGIMETER2_SERIAL_H */
@@ -0,0 +1,26 @@
+/*
+ * Vegimeter 2 stack high-water marks
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "stack.h"
+
+void stack_paint(int* stack, unsigned int size) {
+  unsigned int i;
+
+  for (i = 0; i < size / sizeof(int); i++) {
+    stack[i] = STACK_PAINT;
+  }
+}
+
+unsigned int stack_used(const int* stack, unsigned int size) {
+  unsigned int i = EXTRA_STACK_BYTES / sizeof(int);
+  unsigned int n = size / sizeof(int);
+
+  while (i < n && stack[i] == (int)STACK_PAINT) {
+    i++;
+  }
+  return (n - i) * sizeof(int);
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_STACK_H
+#define __VEGIMETER2_STACK_H
+
+#include <stdint.h>
+
+/*
+ * Stack high-water marks. The stack of a cog is painted with STACK_PAINT
+ * before the cog starts. Stacks grow down from the top of their array and
+ * cogstart() keeps the thread state, EXTRA_STACK_BYTES, at the bottom, so
+ * the words in between that still hold the paint were never reached.
+ *
+ * A function may reserve a frame without writing all of it, the mark is a
+ * lower bound of the depth. The static report of tools/vegimeter_mem.py is
+ * the upper bound.
+ */
+#define STACK_PAINT 0x5354414B /* "STAK" */
+
+/* Paints the whole stack, size in bytes. */
+void stack_paint(int* stack, unsigned int size);
+/* Bytes of the stack above the thread state that were ever written. */
+unsigned int stack_used(const int* stack, unsigned int size);
+
+#endif /* __VEGIMETER2_STACK_H */
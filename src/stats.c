@@ -0,0 +1,120 @@
+/*
+ * Vegimeter 2 rolling sensor statistics
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "mailbox.h"
+#include "sensors.h"
+#include "stats.h"
+
+#define SAMPLES_PER_HOUR (3600000 / SENSING_PERIOD)
+
+HUBDATA struct stats_mailbox stats_mailbox;
+HUBDATA static const uint8_t stats_window_sizes[STATS_NUM_WINDOWS] =
+  STATS_WINDOW_SIZES;
+
+void stats_init() {
+  int8_t i, j;
+
+  memset(&stats_mailbox, 0, sizeof(stats_mailbox));
+  for (i = 0; i < NUM_SENSORS; i++) {
+    for (j = 0; j < STATS_NUM_WINDOWS; j++) {
+      stats_mailbox.data[i].window[j].size = stats_window_sizes[j];
+    }
+  }
+}
+
+void stats_push(int8_t role, int temp) {
+  struct sensor_stats* st = &stats_mailbox.data[role];
+  struct stats_window* w;
+  int16_t y = temp;
+  int16_t old;
+  int8_t i;
+
+  for (i = 0; i < STATS_NUM_WINDOWS; i++) {
+    w = &st->window[i];
+    if (w->n < w->size) {
+      w->ksum += (int32_t)w->n * y;
+      w->n++;
+    } else {
+      /* The oldest sample leaves, the others move down by one. */
+      old = st->ring[(st->count - w->size) & STATS_RING_MASK];
+      w->ksum += (int32_t)(w->size - 1) * y - (w->sum - old);
+      w->sum -= old;
+      w->sqsum -= (int32_t)old * old;
+    }
+    w->sum += y;
+    w->sqsum += (int32_t)y * y;
+  }
+  st->ring[st->count & STATS_RING_MASK] = y;
+  st->count++;
+}
+
+static uint32_t isqrt(uint32_t v) {
+  uint32_t r = 0;
+  uint32_t bit = 1UL << 30;
+
+  while (bit > v) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (v >= r + bit) {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return r;
+}
+
+static int16_t clamp16(int64_t v) {
+  return v > 32767 ? 32767 : v < -32767 ? -32767 : (int16_t)v;
+}
+
+static void stats_compute(const struct sensor_stats* st, int8_t window,
+                          struct stats_summary* s) {
+  const struct stats_window* w = &st->window[window];
+  int32_t n = w->n;
+  int64_t var;
+  uint32_t i;
+  int16_t y;
+
+  memset(s, 0, sizeof(*s));
+  if (n == 0) {
+    return;
+  }
+  s->n = n;
+  s->mean = w->sum / n;
+  s->min = s->max = st->ring[(st->count - 1) & STATS_RING_MASK];
+  for (i = st->count - n; i != st->count; i++) {
+    y = st->ring[i & STATS_RING_MASK];
+    if (y < s->min) {
+      s->min = y;
+    } else if (y > s->max) {
+      s->max = y;
+    }
+  }
+  var = (n * w->sqsum - (int64_t)w->sum * w->sum) / ((int64_t)n * n);
+  s->stddev = isqrt(var > 0xFFFFFFFFLL ? 0xFFFFFFFFU : (uint32_t)var);
+  if (n >= 2) {
+    /* Least squares slope over k = 0..n-1, per sample, then per hour. */
+    s->slope = clamp16(((int64_t)12 * w->ksum - (int64_t)6 * (n - 1) * w->sum) *
+                       SAMPLES_PER_HOUR / ((int64_t)n * (n * n - 1)));
+  }
+}
+
+void stats_summary(int8_t role, int8_t window, struct stats_summary* s) {
+  uint32_t seq;
+
+  do {
+    while ((seq = stats_mailbox.seq) & 1) {
+    }
+    mailbox_barrier();
+    stats_compute(&stats_mailbox.data[role], window, s);
+    mailbox_barrier();
+  } while (seq != stats_mailbox.seq);
+}
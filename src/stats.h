@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_STATS_H
+#define __VEGIMETER2_STATS_H
+
+#include <stdint.h>
+#include "sensors.h"
+
+/* Samples kept per sensor, a power of two at least the longest window. */
+#define STATS_RING_SIZE 64
+#define STATS_RING_MASK (STATS_RING_SIZE - 1)
+
+/* Windows, in samples of SENSING_PERIOD. */
+#define STATS_WINDOW_SHORT 0 /* 1 minute */
+#define STATS_WINDOW_LONG 1 /* 5 minutes */
+#define STATS_NUM_WINDOWS 2
+#define STATS_WINDOW_SIZES { 12, 60 }
+
+/*
+ * Running sums over the last size valid samples, k = 0 for the oldest.
+ * Sliding the window by one sample updates them with a few additions and
+ * one multiplication by a constant, no division and no loop.
+ */
+struct stats_window {
+  uint8_t size; /* Samples */
+  uint8_t n; /* Samples in the window so far */
+  int32_t sum; /* Sum of y */
+  int32_t ksum; /* Sum of k * y */
+  int64_t sqsum; /* Sum of y * y */
+};
+
+struct sensor_stats {
+  int16_t ring[STATS_RING_SIZE]; /* Centi-Celsius */
+  uint32_t count; /* Samples pushed */
+  struct stats_window window[STATS_NUM_WINDOWS];
+};
+
+/*
+ * The statistics of every sensor role, updated in place by the sensing cog
+ * after each sample under the mailbox seq. Readers compute summaries from
+ * the sums right there and retry if the sensing cog got in between.
+ */
+struct stats_mailbox {
+  volatile uint32_t seq;
+  struct sensor_stats data[NUM_SENSORS];
+};
+
+extern struct stats_mailbox stats_mailbox;
+
+/* Summary of a window, all in centi-Celsius. */
+struct stats_summary {
+  uint8_t n; /* Samples, 0 when there is nothing to sum up */
+  int16_t mean;
+  int16_t min;
+  int16_t max;
+  uint16_t stddev;
+  int16_t slope; /* Least squares, centi-Celsius per hour */
+};
+
+void stats_init();
+/* Sensing cog, between mailbox_write_begin() and mailbox_write_end(): adds
+ * a valid reading to the statistics of the role. */
+void stats_push(int8_t role, int temp);
+/* Any cog. Division and the min/max scan only happen here. */
+void stats_summary(int8_t role, int8_t window, struct stats_summary* s);
+
+#endif /* __VEGIMETER2_STATS_H */
@@ -0,0 +1,431 @@
+/*
+ * Vegimeter 2 telemetry and UI
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "buttons.h"
+#include "engine.h"
+#include "frame.h"
+#include "history.h"
+#include "idle.h"
+#include "pins.h"
+#include "prof.h"
+#include "sched.h"
+#include "sensors.h"
+#include "stack.h"
+#include "stats.h"
+#include "telemetry.h"
+#include "warm.h"
+#include "xbee_api.h"
+#include "xbee_rx.h"
+#include "xbee_tx.h"
+
+HUBDATA int8_t led = 0;
+HUBDATA static int8_t led_pin = -1; /* Lit by the animation */
+HUBDATA static int8_t led_step = -1; /* Of the animation, -1 when idle */
+
+HUBDATA static struct control_snapshot report;
+HUBDATA static uint32_t last_seq = 0;
+HUBDATA static int8_t boot_reported = 0;
+HUBDATA static struct idle_stats idle_reported[IDLE_NUM_COGS];
+HUBDATA static int8_t reports = 0;
+#ifdef VEGIMETER_PROFILE
+HUBDATA static uint32_t prof_reported[PROF_NUM_PHASES][PROF_BUCKETS];
+#endif
+
+HUBDATA static struct xbee_api_parser radio;
+HUBDATA static struct frame_parser command;
+HUBDATA static uint8_t dump_page[EEPROM_PAGE_SIZE];
+HUBDATA static uint16_t dump_index;
+
+unsigned int telemetry_leds();
+
+HUBDATA struct sched telemetry_sched;
+HUBDATA static struct sched_task telemetry_tasks[TELEMETRY_NUM_TASKS] = {
+  { telemetry_step, TELEMETRY_POLL_PERIOD },
+  { telemetry_leds, TELEMETRY_LED_STEP },
+  { telemetry_host, TELEMETRY_HOST_POLL_PERIOD },
+  { telemetry_buttons, TELEMETRY_BUTTONS_POLL_PERIOD },
+};
+
+void led_init() {
+  DIR_OUTPUT(23);
+  DIR_OUTPUT(22);
+  DIR_OUTPUT(21);
+  DIR_OUTPUT(20);
+  DIR_OUTPUT(19);
+  DIR_OUTPUT(18);
+  DIR_OUTPUT(17);
+  DIR_OUTPUT(16);
+}
+
+void led_on(int pin) {
+  OUT_HIGH(pin);
+  led = 1;
+}
+
+void led_off(int pin) {
+  OUT_LOW(pin);
+  led = 0;
+}
+
+void error_leds() {
+  int i;
+
+  for (i = 16; i <= 23; i++) {
+    led_on(i);
+  }
+}
+
+void blink_led() {
+  int pin = 20;
+
+  led_on(pin);
+  idle_ms(IDLE_TELEMETRY, 500);
+  led_off(pin);  
+}
+
+void telemetry_send_boot(int8_t num_found, int8_t num_sensors) {
+  frame_begin(FRAME_BOOT, FRAME_BOOT_SIZE);
+  frame_put_u8(num_found);
+  frame_put_u8(num_sensors);
+  frame_end();
+}
+
+void engine_runnerT() {
+  led_init();
+  while (1) {
+    blink_led();
+    telemetry_send_boot(0, 0);
+    idle_ms(IDLE_ENGINE, 500);
+  }
+}
+
+void telemetry_send_status(struct control_snapshot* c) {
+  uint32_t dropped = xbee_tx_dropped();
+  int8_t i;
+
+  frame_begin(FRAME_STATUS, FRAME_STATUS_SIZE);
+  for (i = 0; i < NUM_SENSORS; i++) {
+    frame_put_temp(c->temp[i]);
+  }
+  frame_put_u8((c->heater ? FRAME_ACTUATOR_HEATER : 0) |
+               (c->pump ? FRAME_ACTUATOR_PUMP : 0));
+  frame_put_u8(c->action);
+  frame_put_u16(c->heater_duty);
+  frame_put_u8(c->heater_periods);
+  frame_put_u8(c->halt);
+  frame_put_u16(dropped > 0xFFFF ? 0xFFFF : dropped);
+  frame_end();
+}
+
+/* Awake and asleep time of every cog since the last FRAME_IDLE. */
+void telemetry_send_idle() {
+  unsigned int us = CLKFREQ / 1000000;
+  struct idle_stats s;
+  uint32_t naps;
+  int8_t i;
+
+  frame_begin(FRAME_IDLE, FRAME_IDLE_SIZE);
+  for (i = 0; i < IDLE_NUM_COGS; i++) {
+    mailbox_read(&idle_mailbox[i], &s);
+    naps = s.naps - idle_reported[i].naps;
+    frame_put_u32((s.awake - idle_reported[i].awake) / us);
+    frame_put_u32((s.asleep - idle_reported[i].asleep) / us);
+    frame_put_u16(naps > 0xFFFF ? 0xFFFF : naps);
+    idle_reported[i] = s;
+  }
+  frame_end();
+}
+
+#define NUM_SCHEDS 3
+
+/* Start lateness and overruns of every scheduler task. */
+void telemetry_send_sched() {
+  struct sched* scheds[] = { &engine_sched, &sensors_sched, &telemetry_sched };
+  unsigned int us = CLKFREQ / 1000000;
+  struct sched_task* t;
+  int8_t i, j, n = 0;
+
+  for (i = 0; i < NUM_SCHEDS; i++) {
+    n += scheds[i]->num_tasks;
+  }
+  frame_begin(FRAME_SCHED, FRAME_SCHED_TASK_SIZE * n);
+  for (i = 0; i < NUM_SCHEDS; i++) {
+    for (j = 0; j < scheds[i]->num_tasks; j++) {
+      t = &scheds[i]->tasks[j];
+      frame_put_u32(t->late_max / us);
+      frame_put_u16(t->overruns);
+    }
+  }
+  frame_end();
+}
+
+/* Long window statistics of every sensor role. */
+void telemetry_send_stats() {
+  static const uint8_t sizes[STATS_NUM_WINDOWS] = STATS_WINDOW_SIZES;
+  struct stats_summary s;
+  int8_t i;
+
+  frame_begin(FRAME_STATS, FRAME_STATS_SIZE);
+  frame_put_u8(sizes[STATS_WINDOW_LONG]);
+  for (i = 0; i < NUM_SENSORS; i++) {
+    stats_summary(i, STATS_WINDOW_LONG, &s);
+    frame_put_u16(s.mean);
+    frame_put_u16(s.min);
+    frame_put_u16(s.max);
+    frame_put_u16(s.stddev);
+    frame_put_u16(s.slope);
+    frame_put_u8(s.n);
+  }
+  frame_end();
+}
+
+/*
+ * Read errors of every sensor role. The counters only grow, so they are
+ * read without the mailbox seq.
+ */
+void telemetry_send_sensor_errors() {
+  int8_t i;
+
+  frame_begin(FRAME_SENSOR_ERRORS, FRAME_SENSOR_ERRORS_SIZE);
+  for (i = 0; i < NUM_SENSORS; i++) {
+    frame_put_u16(sensors_mailbox.data.errors[i]);
+    frame_put_u16(sensors_mailbox.data.failures[i]);
+  }
+  frame_end();
+}
+
+/* Stack high-water marks of the cogs, see stack.h. */
+void telemetry_send_memory() {
+  int8_t i;
+
+  frame_begin(FRAME_MEMORY, FRAME_MEMORY_SIZE);
+  frame_put_u8(NUM_STARTED_COGS);
+  for (i = 0; i < NUM_STARTED_COGS; i++) {
+    frame_put_u16(engine_cogs[i].size - EXTRA_STACK_BYTES);
+    frame_put_u16(stack_used(engine_cogs[i].stack, engine_cogs[i].size));
+  }
+  frame_end();
+}
+
+void telemetry_send_model(struct control_snapshot* c) {
+  int8_t i;
+
+  frame_begin(FRAME_MODEL, FRAME_MODEL_SIZE);
+  frame_put_u8(c->model_valid ? FRAME_MODEL_VALID : 0);
+  frame_put_u16(c->model_samples);
+  for (i = 0; i < RLS_N; i++) {
+    frame_put_u32(c->soil_model[i]);
+  }
+  for (i = 0; i < RLS_N; i++) {
+    frame_put_u32(c->water_model[i]);
+  }
+  frame_end();
+}
+
+#ifdef VEGIMETER_PROFILE
+/* Phase histograms, the runs since the previous FRAME_PROFILE. */
+void telemetry_send_profile() {
+  struct prof_hist h;
+  uint32_t n;
+  int8_t i, b;
+
+  frame_begin(FRAME_PROFILE, FRAME_PROFILE_SIZE);
+  frame_put_u8(PROF_NUM_PHASES);
+  frame_put_u8(CLKFREQ / 1000000);
+  for (i = 0; i < PROF_NUM_PHASES; i++) {
+    mailbox_read(&prof_mailbox[i], &h);
+    frame_put_u32(h.max);
+    for (b = 0; b < PROF_BUCKETS; b++) {
+      n = h.count[b] - prof_reported[i][b];
+      frame_put_u16(n > 0xFFFF ? 0xFFFF : n);
+      prof_reported[i][b] = h.count[b];
+    }
+  }
+  frame_end();
+}
+#endif
+
+/*
+ * LED animation task. After every report pin 20 blinks for 500 ms, then
+ * the LEDs strobe from 16 to 23, 200 ms each. It sleeps in between.
+ */
+unsigned int telemetry_leds() {
+  int8_t pin;
+
+  if (led_step < 0) {
+    return IDLE_MAX_MS;
+  }
+  PROF_BEGIN(PROF_LEDS);
+  if (led_step < LED_BLINK_STEPS) {
+    pin = 20;
+  } else if (led_step < LED_BLINK_STEPS + 8 * LED_STROBE_STEPS) {
+    pin = 16 + (led_step - LED_BLINK_STEPS) / LED_STROBE_STEPS;
+  } else {
+    pin = -1;
+  }
+  if (pin != led_pin) {
+    if (led_pin >= 0) {
+      led_off(led_pin);
+    }
+    if (pin >= 0) {
+      led_on(pin);
+    }
+    led_pin = pin;
+  }
+  led_step = pin < 0 ? -1 : led_step + 1;
+  PROF_END(PROF_LEDS);
+  return 0;
+}
+
+void telemetry_send_history(uint8_t* page, uint8_t flags) {
+  frame_begin(FRAME_HISTORY, FRAME_HISTORY_SIZE);
+  frame_put_u16(dump_index++);
+  frame_put_u8(flags);
+  frame_put(page, EEPROM_PAGE_SIZE);
+  frame_end();
+}
+
+/* A frame from the XBee: the TX status of a packet of the XBee cog, or a
+ * packet from the host with commands in it. */
+static void telemetry_radio(uint16_t length) {
+  struct xbee_packet packet;
+  uint8_t i;
+
+  if (radio.frame[0] == XBEE_API_TX_STATUS) {
+    if (length >= 3) {
+      xbee_tx_status(radio.frame[1], radio.frame[2]);
+    }
+    return;
+  }
+  if (xbee_api_packet(radio.frame, length, &packet) < 0 ||
+      (packet.api_id != XBEE_API_RX16 && packet.api_id != XBEE_API_RX64)) {
+    return;
+  }
+  for (i = 0; i < packet.size; i++) {
+    switch (frame_parse(&command, packet.data[i])) {
+    case FRAME_CMD_HISTORY_DUMP:
+      if (!history_dumping()) {
+        dump_index = 0;
+        history_dump_begin();
+      }
+      break;
+    case FRAME_CMD_COLD_START:
+      warm_clear();
+      break;
+    }
+  }
+}
+
+/*
+ * Host task. A history dump goes out a page per frame as fast as the XBee
+ * takes them, but leaves room in the transmit buffer for the reports.
+ */
+unsigned int telemetry_host() {
+  uint16_t length;
+  int c;
+
+  while ((c = xbee_getc()) >= 0) {
+    length = xbee_api_parse(&radio, c);
+    if (length > 0) {
+      telemetry_radio(length);
+    }
+  }
+  while (history_dumping() && xbee_tx_free() >=
+         FRAME_SIZE(FRAME_HISTORY_SIZE) + TELEMETRY_REPORT_ROOM) {
+    history_dump_next(dump_page);
+    telemetry_send_history(dump_page,
+                           history_dumping() ? 0 : FRAME_HISTORY_LAST);
+  }
+  return 0;
+}
+
+/* Drains the button ring in batches, as long as the XBee takes them. */
+unsigned int telemetry_buttons() {
+  struct button_event events[FRAME_BUTTONS_MAX];
+  uint32_t dropped;
+  int8_t i, n;
+
+  while (xbee_tx_free() >=
+         FRAME_SIZE(FRAME_BUTTONS_SIZE(FRAME_BUTTONS_MAX)) &&
+         (n = button_ring_drain(&buttons, events, FRAME_BUTTONS_MAX)) > 0) {
+    dropped = buttons.dropped;
+    frame_begin(FRAME_BUTTONS, FRAME_BUTTONS_SIZE(n));
+    frame_put_u8(n);
+    frame_put_u16(dropped > 0xFFFF ? 0xFFFF : dropped);
+    for (i = 0; i < n; i++) {
+      frame_put_u8(events[i].button |
+                   (events[i].edge == BUTTON_PRESS ? FRAME_BUTTON_PRESS : 0));
+      frame_put_u32(events[i].cnt);
+    }
+    frame_end();
+  }
+  return 0;
+}
+
+void telemetry_report(struct control_snapshot* c) {
+  history_append(c, telemetry_sched.now / CLKFREQ);
+  warm_save(c);
+  telemetry_send_status(c);
+  telemetry_send_idle();
+  telemetry_send_sched();
+  if (++reports >= TELEMETRY_STATS_REPORTS) {
+    reports = 0;
+    telemetry_send_stats();
+    telemetry_send_sensor_errors();
+    telemetry_send_memory();
+    telemetry_send_model(c);
+  }
+#ifdef VEGIMETER_PROFILE
+  /* Halfway between the statistics, when the buffer has room for it. The
+   * runs add up until then. */
+  if (reports == TELEMETRY_STATS_REPORTS / 2 &&
+      xbee_tx_free() >= FRAME_SIZE(FRAME_PROFILE_SIZE)) {
+    telemetry_send_profile();
+  }
+#endif
+  if (c->action == ACTION_HALTED) {
+    led_step = -1;
+    led_pin = -1;
+    error_leds();
+    return;
+  }
+  led_step = 0;
+  sched_wake(&telemetry_sched, &telemetry_tasks[TELEMETRY_TASK_LEDS]);
+}
+
+void telemetry_init() {
+  led_init();
+  history_init();
+  xbee_api_parser_init(&radio);
+  frame_parser_init(&command);
+  sched_init(&telemetry_sched, telemetry_tasks, TELEMETRY_NUM_TASKS,
+             IDLE_TELEMETRY);
+}
+
+unsigned int telemetry_step() {
+  uint32_t seq;
+
+  if (!boot_reported && sensors_mailbox.seq >= 2) {
+    boot_reported = 1;
+    telemetry_send_boot(sensors_mailbox.data.num_found,
+                        sensors_mailbox.data.num_sensors);
+  }
+  seq = mailbox_read(&control_mailbox, &report);
+  if (seq == last_seq) {
+    return 0;
+  }
+  last_seq = seq;
+  PROF_BEGIN(PROF_REPORT);
+  telemetry_report(&report);
+  PROF_END(PROF_REPORT);
+  return 0;
+}
+
+void telemetry_runner(void* par) {
+  telemetry_init();
+  sched_run(&telemetry_sched);
+}
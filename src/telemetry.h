@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_TELEMETRY_H
+#define __VEGIMETER2_TELEMETRY_H
+
+#include "sched.h"
+
+/* How often the telemetry cog looks for a new control snapshot. */
+#define TELEMETRY_POLL_PERIOD 100 // Milliseconds
+
+/* The rolling statistics summary goes with every that many reports. */
+#define TELEMETRY_STATS_REPORTS 5
+
+/* LED animation, in steps of TELEMETRY_LED_STEP. */
+#define TELEMETRY_LED_STEP 100 // Milliseconds
+#define LED_BLINK_STEPS 5
+#define LED_STROBE_STEPS 2
+
+/* How often the telemetry cog looks for commands from the host. */
+#define TELEMETRY_HOST_POLL_PERIOD 50 // Milliseconds
+/* How often the telemetry cog forwards the button events. */
+#define TELEMETRY_BUTTONS_POLL_PERIOD 20 // Milliseconds
+/* Transmit buffer kept free for the report frames while dumping the
+ * history, they take about 220 bytes. */
+#define TELEMETRY_REPORT_ROOM 256
+
+/* Telemetry cog tasks, see sched.h. */
+#define TELEMETRY_TASK_REPORT 0
+#define TELEMETRY_TASK_LEDS 1
+#define TELEMETRY_TASK_HOST 2
+#define TELEMETRY_TASK_BUTTONS 3
+#define TELEMETRY_NUM_TASKS 4
+
+/*
+ * Telemetry and UI cog: sends every control snapshot over the XBee as a
+ * FRAME_STATUS frame, logs it to the history in the EEPROM, answers the
+ * host commands, forwards the button events and animates the LEDs. Owns
+ * the XBee, the EEPROM and the LED pins.
+ */
+extern struct sched telemetry_sched;
+
+void telemetry_init();
+/* Task, reports the control snapshot if it changed. */
+unsigned int telemetry_step();
+/* Task, runs the host commands, hands the TX status of the packets to the
+ * XBee cog and streams the history dump. */
+unsigned int telemetry_host();
+/* Task, sends the queued button events as FRAME_BUTTONS. */
+unsigned int telemetry_buttons();
+void telemetry_runner(void* par);
+
+#endif /* __VEGIMETER2_TELEMETRY_H */
@@ -15,26 +15,30 @@
  */
 
 #include "vegimeter_config.h"
+#include "button_ring.h"
+#include "fmt.h"
+#include "serial.h"
 
 #include <bb/os.h>
 #include <bb/os/kernel/delay.h>
-#include BBOS_PROCESSOR_FILE(shmem.h)
-#include BBOS_PROCESSOR_FILE(sio.h)
 
 void
 ui_runner()
 {
-  uint8_t i = 0;
-  int8_t vegimeter_buttons;
-  /* Read buttons state from the shared memory. */
-  vegimeter_buttons = shmem_read_byte(VEGIMETER_BUTTONS_ADDR);
-  if (vegimeter_buttons) {
-    for (i = 0; i < 8; i++, vegimeter_buttons >>= 1) {
-      if (vegimeter_buttons & 1) {
-        sio_printf("Button pressed: %d\n", i);
-      }
-    }
-    /* Zero buttons state */
-    shmem_write_byte(VEGIMETER_BUTTONS_ADDR, 0);
+  struct button_event events[BUTTON_RING_SIZE];
+  char line[40];
+  char* p;
+  int i, n;
+
+  /* Everything the control panel queued since the previous run. */
+  n = button_ring_drain(VEGIMETER_BUTTONS, events, BUTTON_RING_SIZE);
+  for (i = 0; i < n; i++) {
+    p = fmt_str(line, events[i].edge == BUTTON_PRESS ? "Button pressed: " :
+                "Button released: ");
+    p = fmt_uint(p, events[i].button);
+    p = fmt_str(p, " at ");
+    p = fmt_uint(p, events[i].cnt);
+    p = fmt_str(p, "\n");
+    serial_write(&serial_console, line, p - line);
   }
 }
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ *
+ * Generated by vegimeter2.py from the mapping, do not edit.
+ */
+#ifndef __VEGIMETER2_TABLES_H
+#define __VEGIMETER2_TABLES_H
+
+/* Sensor roles. Also used as indices into the sensor table. */
+#define SENSOR_AIR 0
+#define SENSOR_SOIL_A 1
+#define SENSOR_SOIL_B 2
+#define SENSOR_SOIL_C 3
+#define SENSOR_SOIL_D 4
+#define SENSOR_WATER_A 5
+#define SENSOR_WATER_B 6
+#define NUM_SENSORS 7
+/* Role names for the host tools. */
+#define SENSOR_NAMES { \
+  "air", \
+  "soil_a", \
+  "soil_b", \
+  "soil_c", \
+  "soil_d", \
+  "water_a", \
+  "water_b", \
+}
+
+/* struct sensor_config rows, in role order. */
+#define SENSOR_CONFIG { \
+  { 8, SENSOR_KIND_AIR, 0, 1, { 0x00 } }, /* SENSOR_AIR */ \
+  { 10, SENSOR_KIND_SOIL, 0, 1, { 0x00 } }, /* SENSOR_SOIL_A */ \
+  { 13, SENSOR_KIND_SOIL, 0, 1, { 0x00 } }, /* SENSOR_SOIL_B */ \
+  { 14, SENSOR_KIND_SOIL, 0, 1, { 0x00 } }, /* SENSOR_SOIL_C */ \
+  { 12, SENSOR_KIND_SOIL, 0, 1, { 0x00 } }, /* SENSOR_SOIL_D */ \
+  { 11, SENSOR_KIND_WATER, 0, 1, { 0x00 } }, /* SENSOR_WATER_A */ \
+  { 9, SENSOR_KIND_WATER, 0, 1, { 0x00 } }, /* SENSOR_WATER_B */ \
+}
+
+/* Cogs with an idle account. */
+#define IDLE_ENGINE 0
+#define IDLE_SENSORS 1
+#define IDLE_TELEMETRY 2
+#define IDLE_XBEE_TX 3
+#define IDLE_ONEWIRE 4
+#define IDLE_NUM_COGS 5
+
+/* Cog stack sizes in ints. */
+#define SENSORS_STACK_SIZE ((EXTRA_STACK_BYTES + 384) / 4)
+#define TELEMETRY_STACK_SIZE ((EXTRA_STACK_BYTES + 640) / 4)
+#define XBEE_TX_STACK_SIZE ((EXTRA_STACK_BYTES + 768) / 4)
+#define ONEWIRE_STACK_SIZE ((EXTRA_STACK_BYTES + 256) / 4)
+#define XBEE_RX_STACK_SIZE ((EXTRA_STACK_BYTES + 128) / 4)
+#define BUTTONS_STACK_SIZE ((EXTRA_STACK_BYTES + 128) / 4)
+
+/* The stacks, named after the cogs, defined once by the engine. */
+#define COG_STACKS \
+  HUBDATA static int sensors_stack[SENSORS_STACK_SIZE]; \
+  HUBDATA static int telemetry_stack[TELEMETRY_STACK_SIZE]; \
+  HUBDATA static int xbee_tx_stack[XBEE_TX_STACK_SIZE]; \
+  HUBDATA static int onewire_stack[ONEWIRE_STACK_SIZE]; \
+  HUBDATA static int xbee_rx_stack[XBEE_RX_STACK_SIZE]; \
+  HUBDATA static int buttons_stack[BUTTONS_STACK_SIZE]
+
+/* struct cog_config rows, in start order. */
+#define NUM_STARTED_COGS 6
+#define COG_CONFIG { \
+  { sensors_runner, sensors_stack, sizeof(sensors_stack) }, \
+  { telemetry_runner, telemetry_stack, sizeof(telemetry_stack) }, \
+  { xbee_tx_runner, xbee_tx_stack, sizeof(xbee_tx_stack) }, \
+  { ow_cog_runner, onewire_stack, sizeof(onewire_stack) }, \
+  { xbee_rx_runner, xbee_rx_stack, sizeof(xbee_rx_stack) }, \
+  { buttons_runner, buttons_stack, sizeof(buttons_stack) }, \
+}
+
+#endif /* __VEGIMETER2_TABLES_H */
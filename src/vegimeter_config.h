@@ -6,6 +6,8 @@
 
 /* Define shared memory space */
 #define VEGIMETER_SHMEM_START_ADDR                        24576 /* 24K */
+/* Button event ring from the control panel to the UI, see button_ring.h. */
 #define VEGIMETER_BUTTONS_ADDR     (VEGIMETER_SHMEM_START_ADDR)
+#define VEGIMETER_BUTTONS ((struct button_ring*)VEGIMETER_BUTTONS_ADDR)
 
 #endif /* __VEGIMETER_CONFIG_H */
@@ -0,0 +1,110 @@
+/*
+ * Vegimeter 2 warm restart
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "eeprom.h"
+#include "frame.h"
+#include "warm.h"
+
+#define SLOT_ADDR(i) (WARM_BASE + (uint16_t)(i) * WARM_SLOT_SIZE)
+
+/* Fails to compile if the state outgrows its slot. */
+typedef char warm_slot_fits[WARM_HEADER_SIZE + sizeof(struct warm_state) <=
+                            WARM_SLOT_SIZE ? 1 : -1];
+
+/* Set by warm_restore() on the engine cog before the telemetry cog runs,
+ * then only used by the telemetry cog. */
+HUBDATA static uint16_t warm_seq;
+HUBDATA static uint16_t warm_next;
+HUBDATA static int8_t warm_cleared = 0;
+
+static uint16_t warm_crc(const struct warm_state* s) {
+  const uint8_t* p = (const uint8_t*)s;
+  uint16_t crc = 0xFFFF;
+  uint8_t i;
+
+  for (i = 0; i < sizeof(*s); i++) {
+    crc = crc16_update(crc, p[i]);
+  }
+  return crc;
+}
+
+int warm_restore(struct warm_state* s) {
+  uint8_t slot[WARM_HEADER_SIZE + sizeof(struct warm_state)];
+  struct warm_state* state = (struct warm_state*)(slot + WARM_HEADER_SIZE);
+  int8_t found = 0;
+  uint16_t i;
+
+  warm_seq = 0;
+  warm_next = 0;
+  for (i = 0; i < WARM_NUM_SLOTS; i++) {
+    if (eeprom_read(SLOT_ADDR(i), slot, sizeof(slot)) ||
+        slot[0] != WARM_MAGIC || slot[1] != WARM_VERSION ||
+        (slot[2] | (slot[3] << 8)) != warm_crc(state)) {
+      continue;
+    }
+    if (!found || (int16_t)(state->seq - s->seq) > 0) {
+      found = 1;
+      memcpy(s, state, sizeof(*s));
+      warm_seq = s->seq + 1;
+      warm_next = (i + 1) % WARM_NUM_SLOTS;
+    }
+  }
+  return found ? 0 : -1;
+}
+
+void warm_save(struct control_snapshot* c) {
+  uint8_t slot[WARM_HEADER_SIZE + sizeof(struct warm_state)];
+  struct warm_state* s = (struct warm_state*)(slot + WARM_HEADER_SIZE);
+  uint16_t crc;
+  int8_t i;
+
+  if (warm_cleared) {
+    return;
+  }
+  memset(s, 0, sizeof(*s));
+  s->seq = warm_seq++;
+  s->pid_integral = c->pid_integral;
+  s->pid_prev_error = c->pid_prev_error;
+  s->heater_duty = c->heater_duty;
+  s->heater_credit = c->heater_credit;
+  for (i = 0; i < NUM_SENSORS; i++) {
+    s->temp[i] = c->temp[i] == DEFAULT_TEMP_READING ||
+        c->temp[i] < -32767 || c->temp[i] > 32767 ?
+        FRAME_NO_READING : c->temp[i];
+  }
+  s->heater_excess = c->heater_excess;
+  s->heater_run = c->heater_run;
+  s->heater = c->heater;
+  s->halt = c->halt;
+  s->pump = c->pump;
+  s->action = c->action;
+  if (c->model_valid) {
+    memcpy(s->soil_model, c->soil_model, sizeof(s->soil_model));
+    memcpy(s->water_model, c->water_model, sizeof(s->water_model));
+    s->model = 1;
+  }
+
+  crc = warm_crc(s);
+  slot[0] = WARM_MAGIC;
+  slot[1] = WARM_VERSION;
+  slot[2] = crc & 0xFF;
+  slot[3] = crc >> 8;
+  eeprom_write_page(SLOT_ADDR(warm_next), slot, sizeof(slot));
+  warm_next = (warm_next + 1) % WARM_NUM_SLOTS;
+}
+
+void warm_clear() {
+  uint8_t erased[WARM_HEADER_SIZE];
+  uint16_t i;
+
+  /* An erased header is enough to void a slot. */
+  memset(erased, 0xFF, sizeof(erased));
+  for (i = 0; i < WARM_NUM_SLOTS; i++) {
+    eeprom_write_page(SLOT_ADDR(i), erased, sizeof(erased));
+  }
+  warm_cleared = 1;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_WARM_H
+#define __VEGIMETER2_WARM_H
+
+#include <stdint.h>
+#include "eeprom.h"
+#include "engine.h"
+#include "history.h"
+
+/*
+ * Warm restart. The telemetry cog saves the control state of every
+ * control snapshot to the EEPROM, and the engine restores the newest one
+ * at boot, before it starts the other cogs. After a brown-out or a reset
+ * the pump and a heater run come back right away, and the PI integral,
+ * the halt, the heater on-time of the MAX_HEATER_PERIODS limit, to the
+ * millisecond, and a valid thermal model carry on where they were, so the
+ * model does not spend another 6 hours learning.
+ *
+ * The snapshots go round the slots of the pages after the history log,
+ * two slots a page. With a snapshot a minute each page is written about
+ * once every 8 minutes, over 15 years for the 1M cycles of the 24LC512.
+ *
+ * Slot layout:
+ *   0  magic     WARM_MAGIC
+ *   1  version   WARM_VERSION
+ *   2  crc       uint16, CRC-16/CCITT of the struct warm_state
+ *   4  struct warm_state, as laid out by the compiler: only the firmware
+ *      that wrote it reads it back, a new build changes WARM_VERSION when
+ *      it changes the struct
+ *
+ * The ERROR_MAX_HEAT and ERROR_HIGH_AIR_TEMP halts are restored as well,
+ * so a reset does not clear them, FRAME_CMD_COLD_START does: the slots are
+ * erased and the next boot is cold. The sensor halts come back by
+ * themselves with the first sample if the fault is still there.
+ */
+#define WARM_BASE (HISTORY_BASE + HISTORY_NUM_PAGES * EEPROM_PAGE_SIZE)
+#define WARM_NUM_PAGES 8
+#define WARM_SLOT_SIZE 64
+#define WARM_NUM_SLOTS (WARM_NUM_PAGES * EEPROM_PAGE_SIZE / WARM_SLOT_SIZE)
+#define WARM_MAGIC 0x57
+#define WARM_VERSION 3
+#define WARM_HEADER_SIZE 4
+
+struct warm_state {
+  uint32_t heater_excess; /* Milliseconds */
+  int32_t pid_integral;
+  int32_t soil_model[RLS_N]; /* Q24, if model */
+  int32_t water_model[RLS_N];
+  uint16_t seq; /* Snapshots saved since the slots were erased, wraps */
+  int16_t pid_prev_error;
+  int16_t heater_duty; /* Permille */
+  int16_t heater_credit; /* Permille */
+  int16_t temp[NUM_SENSORS]; /* As in FRAME_STATUS */
+  int8_t heater_run; /* Periods left in the run */
+  int8_t heater; /* On in this period */
+  int8_t halt;
+  int8_t pump;
+  int8_t action;
+  int8_t model; /* The model was valid */
+};
+
+/*
+ * Boot, on the engine cog before the telemetry cog takes the EEPROM.
+ * Returns 0 and the newest snapshot, or -1 for a cold start.
+ */
+int warm_restore(struct warm_state* s);
+/* Telemetry cog, saves the state of the snapshot in the next slot. */
+void warm_save(struct control_snapshot* c);
+/* Telemetry cog, erases the slots and saves nothing more until reset. */
+void warm_clear();
+
+#endif /* __VEGIMETER2_WARM_H */
@@ -0,0 +1,168 @@
+/*
+ * Vegimeter 2 XBee API frames
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include <stddef.h>
+#include "hal.h"
+#include "xbee_api.h"
+
+void xbee_addr16(struct xbee_addr* addr, uint16_t a) {
+  addr->size = 2;
+  addr->bytes[0] = a >> 8;
+  addr->bytes[1] = a & 0xFF;
+}
+
+static uint16_t xbee_api_put(uint8_t* out, uint16_t n, uint8_t b) {
+  if (b == XBEE_API_START || b == XBEE_API_ESCAPE || b == XBEE_API_XON ||
+      b == XBEE_API_XOFF) {
+    out[n++] = XBEE_API_ESCAPE;
+    b ^= XBEE_API_ESCAPE_XOR;
+  }
+  out[n++] = b;
+  return n;
+}
+
+/* Encodes the frame data head then data. */
+static uint16_t xbee_api_encode(uint8_t* out, const uint8_t* head,
+                                uint8_t head_size, const uint8_t* data,
+                                uint8_t size) {
+  uint16_t length = head_size + size;
+  uint16_t n = 0;
+  uint8_t sum = 0;
+  uint8_t i;
+
+  out[n++] = XBEE_API_START;
+  n = xbee_api_put(out, n, length >> 8);
+  n = xbee_api_put(out, n, length & 0xFF);
+  for (i = 0; i < head_size; i++) {
+    sum += head[i];
+    n = xbee_api_put(out, n, head[i]);
+  }
+  for (i = 0; i < size; i++) {
+    sum += data[i];
+    n = xbee_api_put(out, n, data[i]);
+  }
+  return xbee_api_put(out, n, 0xFF - sum);
+}
+
+uint16_t xbee_api_tx(uint8_t* out, uint8_t frame_id,
+                     const struct xbee_addr* dest, uint8_t options,
+                     const uint8_t* data, uint8_t size) {
+  uint8_t head[11];
+  uint8_t i;
+
+  head[0] = dest->size == 2 ? XBEE_API_TX16 : XBEE_API_TX64;
+  head[1] = frame_id;
+  for (i = 0; i < dest->size; i++) {
+    head[2 + i] = dest->bytes[i];
+  }
+  head[2 + i] = options;
+  return xbee_api_encode(out, head, 3 + i, data, size);
+}
+
+void xbee_api_parser_init(struct xbee_api_parser* p) {
+  p->pos = -1;
+  p->escaped = 0;
+}
+
+uint16_t xbee_api_parse(struct xbee_api_parser* p, uint8_t b) {
+  if (b == XBEE_API_START) {
+    /* Never escaped, a new frame even in the middle of another one. */
+    p->pos = 0;
+    p->escaped = 0;
+    p->sum = 0;
+    return 0;
+  }
+  if (p->pos < 0) {
+    return 0;
+  }
+  if (b == XBEE_API_ESCAPE) {
+    p->escaped = 1;
+    return 0;
+  }
+  if (p->escaped) {
+    b ^= XBEE_API_ESCAPE_XOR;
+    p->escaped = 0;
+  }
+  if (p->pos == 0) {
+    p->length = b << 8;
+  } else if (p->pos == 1) {
+    p->length |= b;
+    if (p->length == 0 || p->length > XBEE_API_MAX_FRAME) {
+      p->pos = -1;
+      return 0;
+    }
+  } else if (p->pos - 2 < p->length) {
+    p->frame[p->pos - 2] = b;
+    p->sum += b;
+  } else {
+    p->pos = -1;
+    return (uint8_t)(p->sum + b) == 0xFF ? p->length : 0;
+  }
+  p->pos++;
+  return 0;
+}
+
+int xbee_api_packet(const uint8_t* frame, uint16_t length,
+                    struct xbee_packet* packet) {
+  uint8_t i = 1;
+  uint8_t j;
+
+  packet->api_id = frame[0];
+  packet->frame_id = 0;
+  packet->rssi = 0;
+  switch (frame[0]) {
+  case XBEE_API_TX64:
+  case XBEE_API_TX16:
+    packet->frame_id = frame[i++];
+    break;
+  case XBEE_API_RX64:
+  case XBEE_API_RX16:
+    break;
+  default:
+    return -1;
+  }
+  packet->addr.size = frame[0] & 0x01 ? 2 : 8;
+  /* The header, then at least no data. */
+  if (length < i + packet->addr.size + 1 + (frame[0] & 0x80 ? 1 : 0)) {
+    return -1;
+  }
+  for (j = 0; j < packet->addr.size; j++) {
+    packet->addr.bytes[j] = frame[i++];
+  }
+  if (frame[0] & 0x80) {
+    packet->rssi = frame[i++];
+  }
+  packet->options = frame[i++];
+  packet->data = frame + i;
+  packet->size = length - i;
+  return 0;
+}
+
+#ifdef VEGIMETER_HOST
+uint16_t xbee_api_rx(uint8_t* out, const struct xbee_addr* src,
+                     uint8_t rssi, uint8_t options, const uint8_t* data,
+                     uint8_t size) {
+  uint8_t head[11];
+  uint8_t i;
+
+  head[0] = src->size == 2 ? XBEE_API_RX16 : XBEE_API_RX64;
+  for (i = 0; i < src->size; i++) {
+    head[1 + i] = src->bytes[i];
+  }
+  head[1 + i] = rssi;
+  head[2 + i] = options;
+  return xbee_api_encode(out, head, 3 + i, data, size);
+}
+
+uint16_t xbee_api_tx_status(uint8_t* out, uint8_t frame_id, uint8_t status) {
+  uint8_t head[3];
+
+  head[0] = XBEE_API_TX_STATUS;
+  head[1] = frame_id;
+  head[2] = status;
+  return xbee_api_encode(out, head, sizeof(head), NULL, 0);
+}
+#endif
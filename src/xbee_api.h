@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_XBEE_API_H
+#define __VEGIMETER2_XBEE_API_H
+
+#include <stdint.h>
+
+/*
+ * XBee API frames, escaped (AP=2), for the 802.15.4 (Series 1) modules.
+ *
+ *   0x7E, length (u16 big endian), frame data, checksum
+ *
+ * The frame data starts with the API identifier. The checksum is 0xFF less
+ * the low byte of the sum of the frame data. Everything after the start
+ * delimiter that is 0x7E, 0x7D, XON or XOFF goes as 0x7D and the byte XOR
+ * 0x20, so an unescaped 0x7E always starts a frame.
+ *
+ * The firmware and the host tools both build on this file, they speak the
+ * same frames.
+ */
+#define XBEE_API_START 0x7E
+#define XBEE_API_ESCAPE 0x7D
+#define XBEE_API_XON 0x11
+#define XBEE_API_XOFF 0x13
+#define XBEE_API_ESCAPE_XOR 0x20
+
+/* API identifiers. */
+#define XBEE_API_TX64 0x00 /* Transmit request, 64-bit destination */
+#define XBEE_API_TX16 0x01 /* Transmit request, 16-bit destination */
+#define XBEE_API_RX64 0x80 /* Received packet, 64-bit source */
+#define XBEE_API_RX16 0x81 /* Received packet, 16-bit source */
+#define XBEE_API_TX_STATUS 0x89
+
+/* TX status. */
+#define XBEE_TX_SUCCESS 0
+#define XBEE_TX_NO_ACK 1
+#define XBEE_TX_CCA_FAILURE 2
+#define XBEE_TX_PURGED 3
+
+/* TX options. */
+#define XBEE_TX_DISABLE_ACK 0x01
+
+/* 16-bit broadcast address. */
+#define XBEE_BROADCAST16 0xFFFF
+
+/* RF payload of one packet. */
+#define XBEE_API_MAX_PAYLOAD 100 // Bytes
+/* Frame data of the longest packet: TX64 and RX64 have 11 bytes of
+ * header. */
+#define XBEE_API_MAX_FRAME (11 + XBEE_API_MAX_PAYLOAD)
+/* Encoded frame, every byte after the start delimiter escaped. */
+#define XBEE_API_MAX_ENCODED (1 + 2 * (2 + XBEE_API_MAX_FRAME + 1))
+
+/* A 16-bit or a 64-bit address, most significant byte first. */
+struct xbee_addr {
+  uint8_t size; /* 2 or 8 */
+  uint8_t bytes[8];
+};
+
+/* A transmit request or a received packet, decoded in place. */
+struct xbee_packet {
+  uint8_t api_id;
+  uint8_t frame_id; /* Transmit requests only, 0 asks for no TX status */
+  uint8_t rssi; /* -dBm, received packets only */
+  uint8_t options;
+  struct xbee_addr addr; /* Destination or source */
+  const uint8_t* data;
+  uint8_t size;
+};
+
+/* Receiver state. */
+struct xbee_api_parser {
+  int16_t pos; /* Unescaped bytes after the start delimiter, -1 outside */
+  uint8_t escaped;
+  uint8_t sum;
+  uint16_t length;
+  uint8_t frame[XBEE_API_MAX_FRAME];
+};
+
+void xbee_addr16(struct xbee_addr* addr, uint16_t a);
+
+void xbee_api_parser_init(struct xbee_api_parser* p);
+/*
+ * Feeds a received byte. Returns the length of the frame data in p->frame
+ * once a frame with a good checksum is complete, 0 otherwise. Frames
+ * longer than XBEE_API_MAX_FRAME are skipped.
+ */
+uint16_t xbee_api_parse(struct xbee_api_parser* p, uint8_t b);
+/* Decodes the frame data of a transmit request or a received packet.
+ * Returns 0, or -1 for other frames. */
+int xbee_api_packet(const uint8_t* frame, uint16_t length,
+                    struct xbee_packet* packet);
+
+/*
+ * Encodes a transmit request of size bytes, up to XBEE_API_MAX_PAYLOAD, to
+ * dest: a TX16 or a TX64 after the size of the address. out takes
+ * XBEE_API_MAX_ENCODED bytes. Returns the encoded size.
+ */
+uint16_t xbee_api_tx(uint8_t* out, uint8_t frame_id,
+                     const struct xbee_addr* dest, uint8_t options,
+                     const uint8_t* data, uint8_t size);
+
+#ifdef VEGIMETER_HOST
+/* The radio side, for the simulators: a received packet from src and the
+ * TX status of a transmit request. */
+uint16_t xbee_api_rx(uint8_t* out, const struct xbee_addr* src,
+                     uint8_t rssi, uint8_t options, const uint8_t* data,
+                     uint8_t size);
+uint16_t xbee_api_tx_status(uint8_t* out, uint8_t frame_id, uint8_t status);
+#endif
+
+#endif /* __VEGIMETER2_XBEE_API_H */
@@ -0,0 +1,57 @@
+/*
+ * Vegimeter 2 XBee receive driver
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "mailbox.h"
+#include "serial.h"
+#include "xbee_rx.h"
+
+HUBDATA struct xbee_rx_ring xbee_rx;
+
+void xbee_rx_put(uint8_t c) {
+  uint32_t head = xbee_rx.head;
+
+  if (head - xbee_rx.tail >= XBEE_RX_BUFFER_SIZE) {
+    xbee_rx.dropped++;
+    return;
+  }
+  xbee_rx.buf[head & XBEE_RX_BUFFER_MASK] = c;
+  mailbox_barrier();
+  xbee_rx.head = head + 1;
+}
+
+int xbee_getc() {
+  uint32_t tail = xbee_rx.tail;
+  uint8_t c;
+
+  if (tail == xbee_rx.head) {
+    return -1;
+  }
+  c = xbee_rx.buf[tail & XBEE_RX_BUFFER_MASK];
+  mailbox_barrier();
+  xbee_rx.tail = tail + 1;
+  return c;
+}
+
+#ifndef VEGIMETER_HOST
+void xbee_rx_runner(void* par) {
+  struct serial port;
+  int c;
+
+  serial_open(&port, SERIAL_NO_PIN, XBEE_RX_PIN, XBEE_RX_BAUDRATE);
+  while (1) {
+    c = serial_getc(&port);
+    /* -1 is a framing error, resynchronize on the next idle line. */
+    if (c >= 0) {
+      xbee_rx_put(c);
+    }
+  }
+}
+#else
+/* The simulator hands the received bytes to xbee_rx_put() itself. */
+void xbee_rx_runner(void* par) {
+}
+#endif
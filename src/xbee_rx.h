@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_XBEE_RX_H
+#define __VEGIMETER2_XBEE_RX_H
+
+#include <stdint.h>
+
+#define XBEE_RX_PIN 25
+#define XBEE_RX_BAUDRATE 9600
+
+/* Must be a power of two. Commands are a few bytes. */
+#define XBEE_RX_BUFFER_SIZE 64
+#define XBEE_RX_BUFFER_MASK (XBEE_RX_BUFFER_SIZE - 1)
+
+/*
+ * XBee receive ring buffer in hub RAM, filled by the XBee receive cog and
+ * read by the telemetry cog. Unlike the transmit side the producer never
+ * overwrites: bytes that find the buffer full are dropped.
+ */
+struct xbee_rx_ring {
+  volatile uint32_t head; /* Moved by the producer */
+  volatile uint32_t tail; /* Moved by the consumer */
+  volatile uint32_t dropped;
+  char buf[XBEE_RX_BUFFER_SIZE];
+};
+
+extern struct xbee_rx_ring xbee_rx;
+
+/* Producer side, appends a received byte. */
+void xbee_rx_put(uint8_t c);
+/* Consumer side, returns the next byte or -1 if there is none. */
+int xbee_getc();
+/*
+ * XBee receive cog: samples the XBee DOUT line in software, 8N1, and
+ * appends the bytes to xbee_rx. serial_getc() blocks, so receiving takes
+ * a cog of its own.
+ */
+void xbee_rx_runner(void* par);
+
+#endif /* __VEGIMETER2_XBEE_RX_H */
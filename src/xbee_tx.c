@@ -0,0 +1,199 @@
+/*
+ * Vegimeter 2 XBee transmit driver
+ *
+ * Copyright (c) 2013 Sladeware LLC
+ */
+
+#include "hal.h"
+#include "engine.h"
+#include "frame.h"
+#include "idle.h"
+#include "mailbox.h"
+#include "prof.h"
+#include "serial.h"
+#include "xbee_tx.h"
+
+HUBDATA struct xbee_tx_ring xbee_tx;
+HUBDATA uint32_t xbee_tx_write;
+HUBDATA static struct serial xbee_serial;
+
+HUBDATA static uint8_t xbee_data[XBEE_API_MAX_PAYLOAD];
+HUBDATA static uint8_t xbee_packet[XBEE_API_MAX_ENCODED];
+
+#ifndef VEGIMETER_HOST
+#include <driver.h>
+
+/* No stdio drivers: _InitIO() opens nothing and none of the stdio code is
+ * linked in. The XBee and the console are serial.h ports. */
+_Driver *_driverlist[] = {
+  NULL
+};
+#endif
+
+void xbee_reserve(uint16_t size) {
+  xbee_tx_write = xbee_tx.head;
+  xbee_tx.reserve = xbee_tx_write + size;
+  mailbox_barrier();
+}
+
+void xbee_commit() {
+  mailbox_barrier();
+  xbee_tx.head = xbee_tx_write;
+}
+
+void xbee_write(const char* data, uint16_t size) {
+  if (size > XBEE_TX_BUFFER_SIZE) {
+    /* Only the newest bytes would survive anyway. */
+    data += size - XBEE_TX_BUFFER_SIZE;
+    size = XBEE_TX_BUFFER_SIZE;
+  }
+  xbee_reserve(size);
+  while (size--) {
+    xbee_put(*data++);
+  }
+  xbee_commit();
+}
+
+void xbee_puts(const char* s) {
+  xbee_write(s, strlen(s));
+}
+
+uint32_t xbee_tx_dropped() {
+  return xbee_tx.dropped;
+}
+
+uint32_t xbee_tx_free() {
+  return XBEE_TX_BUFFER_SIZE - (xbee_tx.head - xbee_tx.tail);
+}
+
+/* Size of the frame at index i of the ring, or 1 if no frame starts there. */
+static uint16_t xbee_tx_record(uint32_t i, uint32_t head) {
+  uint16_t size;
+
+  if (head - i < FRAME_HEADER_SIZE ||
+      xbee_tx.buf[i & XBEE_TX_BUFFER_MASK] != (char)FRAME_SYNC0 ||
+      xbee_tx.buf[(i + 1) & XBEE_TX_BUFFER_MASK] != (char)FRAME_SYNC1) {
+    return 1;
+  }
+  size = FRAME_SIZE((uint8_t)xbee_tx.buf[(i + 4) & XBEE_TX_BUFFER_MASK]);
+  return size < head - i ? size : head - i;
+}
+
+uint8_t xbee_tx_gather(uint8_t* data, uint8_t size) {
+  uint32_t tail, head, oldest;
+  uint16_t n, record, i;
+
+  while (1) {
+    tail = xbee_tx.tail;
+    head = xbee_tx.head;
+    mailbox_barrier();
+    for (n = 0; n < size && tail + n != head; n += record) {
+      record = xbee_tx_record(tail + n, head);
+      if (n + record > size) {
+        if (n > 0) {
+          break;
+        }
+        record = size;
+      }
+      for (i = 0; i < record; i++) {
+        data[n + i] = xbee_tx.buf[(tail + n + i) & XBEE_TX_BUFFER_MASK];
+      }
+    }
+    mailbox_barrier();
+    oldest = xbee_tx.reserve - XBEE_TX_BUFFER_SIZE;
+    if ((int32_t)(tail - oldest) < 0) {
+      /* Overwritten while copying, drop the oldest bytes. */
+      xbee_tx.dropped += oldest - tail;
+      xbee_tx.tail = oldest;
+      continue;
+    }
+    xbee_tx.tail = tail + n;
+    return n;
+  }
+}
+
+void xbee_tx_status(uint8_t frame_id, uint8_t status) {
+  xbee_tx.status = frame_id << 8 | status;
+}
+
+static uint8_t xbee_tx_wait_status(uint8_t frame_id) {
+  unsigned int start = CNT;
+  uint16_t status;
+
+  while (CNT - start < XBEE_TX_STATUS_TIMEOUT * (CLKFREQ / 1000)) {
+    status = xbee_tx.status;
+    if (status >> 8 == frame_id) {
+      return status & 0xFF;
+    }
+    idle_ms(IDLE_XBEE_TX, XBEE_TX_POLL_PERIOD);
+  }
+  return XBEE_TX_NO_STATUS;
+}
+
+static void xbee_send(const uint8_t* data, uint16_t size) {
+  PROF_BEGIN(PROF_XBEE_SEND);
+  serial_write(&xbee_serial, data, size);
+  PROF_END(PROF_XBEE_SEND);
+}
+
+void engine_xbee_init() {
+  /* The XBee receive cog owns DOUT. */
+  serial_open(&xbee_serial, XBEE_TX_PIN, SERIAL_NO_PIN, XBEE_TX_BAUDRATE);
+  /* API mode with escaping. It is not written to the XBee, every boot
+   * sets it again. MY, the 16-bit address of the unit, is set once when
+   * the unit joins the network; the coordinator keeps MY at 0. */
+  idle_ms(IDLE_XBEE_TX, XBEE_GUARD_TIME);
+  serial_puts(&xbee_serial, "+++");
+  idle_ms(IDLE_XBEE_TX, XBEE_GUARD_TIME);
+  serial_puts(&xbee_serial, "ATAP2,CN\r");
+}
+
+void xbee_tx_runner(void* par) {
+  struct xbee_addr coordinator;
+  uint8_t frame_id = 0;
+  uint8_t status, size;
+  uint16_t packet_size;
+  int8_t waited = 0;
+  int8_t tries;
+  uint32_t available;
+
+  xbee_addr16(&coordinator, XBEE_COORDINATOR16);
+  engine_xbee_init();
+  while (1) {
+    available = xbee_tx.head - xbee_tx.tail;
+    if (available == 0 || (available < XBEE_API_MAX_PAYLOAD && !waited)) {
+      /* Frames come in bursts, a report is several of them. */
+      waited = available != 0;
+      idle_ms(IDLE_XBEE_TX, waited ? XBEE_TX_GATHER_PERIOD :
+              XBEE_TX_POLL_PERIOD);
+      continue;
+    }
+    waited = 0;
+    size = xbee_tx_gather(xbee_data, XBEE_API_MAX_PAYLOAD);
+    if (size == 0) {
+      continue;
+    }
+    /* 0 would ask for no TX status. */
+    if (++frame_id == 0) {
+      frame_id = 1;
+    }
+    packet_size = xbee_api_tx(xbee_packet, frame_id, &coordinator, 0,
+                              xbee_data, size);
+    xbee_tx.packets++;
+    for (tries = 0; ; tries++) {
+      xbee_send(xbee_packet, packet_size);
+      status = xbee_tx_wait_status(frame_id);
+      /* Without a status it may have gone through, better a gap than a
+       * duplicate. */
+      if (status == XBEE_TX_SUCCESS || status == XBEE_TX_NO_STATUS) {
+        break;
+      }
+      if (tries == XBEE_TX_RETRIES) {
+        xbee_tx.failed++;
+        xbee_tx.dropped += size;
+        break;
+      }
+      xbee_tx.retries++;
+    }
+  }
+}
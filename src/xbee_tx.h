@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2013 Sladeware LLC
+ */
+#ifndef __VEGIMETER2_XBEE_TX_H
+#define __VEGIMETER2_XBEE_TX_H
+
+#include <stdint.h>
+#include "xbee_api.h"
+
+/* XBee DIN. */
+#define XBEE_TX_PIN 24
+#define XBEE_TX_BAUDRATE 9600
+
+/* Must be a power of two. */
+#define XBEE_TX_BUFFER_SIZE 512
+#define XBEE_TX_BUFFER_MASK (XBEE_TX_BUFFER_SIZE - 1)
+
+/* How long the XBee cog sleeps when the buffer is empty. About ten bytes
+ * at 9600 baud, far less than the buffer. */
+#define XBEE_TX_POLL_PERIOD 10 // Milliseconds
+/* How long the XBee cog waits for the rest of a burst of frames before it
+ * sends a packet that is not full. */
+#define XBEE_TX_GATHER_PERIOD 20 // Milliseconds
+/* TX status: how long to wait for it, and how many times a packet that
+ * the coordinator did not take is sent again. The status comes through
+ * the telemetry cog, see telemetry_host(). */
+#define XBEE_TX_STATUS_TIMEOUT 500 // Milliseconds
+#define XBEE_TX_RETRIES 2
+/* Returned when no TX status came in time. */
+#define XBEE_TX_NO_STATUS 0xFF
+
+/* The reports go to the coordinator, at its default 16-bit address. */
+#define XBEE_COORDINATOR16 0x0000
+/* Guard time around the +++ escape sequence, GT, with some margin. */
+#define XBEE_GUARD_TIME 1100 // Milliseconds
+
+/*
+ * XBee transmit ring buffer in hub RAM, drained by the XBee cog.
+ *
+ * There is one producer cog (telemetry) and one consumer cog (XBee). The
+ * indices run freely and only the producer moves head, so appending never
+ * blocks. When the producer laps the consumer the oldest bytes are
+ * overwritten: the consumer notices that the byte it has just read is no
+ * longer in the window, skips to the oldest byte still in the buffer and
+ * adds the skipped bytes to dropped.
+ */
+struct xbee_tx_ring {
+  volatile uint32_t head; /* Committed by the producer */
+  volatile uint32_t reserve; /* Written up to here by the producer */
+  volatile uint32_t tail; /* Moved by the consumer */
+  volatile uint32_t dropped;
+  /* Last TX status, frame id << 8 | status. Written by the telemetry cog. */
+  volatile uint16_t status;
+  /* Sent by the XBee cog, sent again, and given up after the retries. */
+  volatile uint32_t packets;
+  volatile uint32_t retries;
+  volatile uint32_t failed;
+  char buf[XBEE_TX_BUFFER_SIZE];
+};
+
+extern struct xbee_tx_ring xbee_tx;
+/* Producer side write index, ahead of head until the commit. */
+extern uint32_t xbee_tx_write;
+
+/*
+ * Appending in place: xbee_reserve() the room, xbee_put() the bytes, then
+ * xbee_commit() them all to the XBee cog at once.
+ */
+void xbee_reserve(uint16_t size);
+void xbee_commit();
+
+static inline void xbee_put(char c) {
+  xbee_tx.buf[xbee_tx_write++ & XBEE_TX_BUFFER_MASK] = c;
+}
+
+void xbee_write(const char* data, uint16_t size);
+void xbee_puts(const char* s);
+uint32_t xbee_tx_dropped();
+/* Producer side, bytes that can be appended without dropping any. */
+uint32_t xbee_tx_free();
+/*
+ * Consumer side, takes the oldest bytes out of the ring for one packet, up
+ * to size. Whole frames are packed while they fit, a frame is only split
+ * over packets if it does not fit in one. Returns how many bytes.
+ */
+uint8_t xbee_tx_gather(uint8_t* data, uint8_t size);
+/* Hands the TX status of a packet to the XBee cog. */
+void xbee_tx_status(uint8_t frame_id, uint8_t status);
+/*
+ * XBee cog: puts the XBee in API mode and sends everything appended to
+ * xbee_tx to the coordinator, as few packets as it can, each one sent
+ * again until its TX status says it was delivered.
+ */
+void xbee_tx_runner(void* par);
+
+#endif /* __VEGIMETER2_XBEE_TX_H */
@@ -0,0 +1,533 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2013 Sladeware LLC.
+#
+# Decoder for the Vegimeter 2 binary telemetry frames, see src/frame.h.
+#
+# Usage: vegimeter_frame.py [--dump] [--cold-start] [--to ADDR]
+#                           [/dev/ttyUSB0 | capture.bin | -]
+#
+# The frames come in XBee API packets (see xbee_api.py), from a capture of
+# the simulator or from the coordinator. The frames of the packets that the
+# coordinator received start with the address of their unit.
+#
+# --dump asks the units for their history log first, see src/history.h:
+# all of them, or only the one at ADDR (4 or 16 hex digits).
+# --cold-start erases their warm restart snapshots, see src/warm.h, so they
+# boot cold and a restored halt is cleared at the next reset.
+
+from __future__ import print_function
+
+import collections
+import os
+import struct
+import sys
+
+import xbee_api
+
+SYNC = b"\xa5\x5a"
+VERSION = 12
+HEADER_SIZE = 7
+CRC_SIZE = 2
+
+NO_READING = -32768
+
+STATUS = 1
+BOOT = 2
+IDLE = 3
+SCHED = 4
+STATS = 5
+HISTORY = 6
+SENSOR_ERRORS = 7
+BUTTONS = 8
+MEMORY = 9
+PROFILE = 10
+MODEL = 11
+
+CMD_HISTORY_DUMP = 0x81
+CMD_COLD_START = 0x82
+
+BUTTON_PRESS = 0x80
+
+HISTORY_LAST = 0x01
+
+MODEL_VALID = 0x01
+MODEL_Q = 1 << 24
+POLLING_PERIOD = 60.0  # Seconds
+HISTORY_MAGIC = 0x48
+HISTORY_VERSION = 1
+HISTORY_HEADER_SIZE = 15
+
+# Sensor roles and idle accounts, in the order of the mapping (vegimeter2.py).
+ROLES = ("air", "soil_a", "soil_b", "soil_c", "soil_d", "water_a", "water_b")
+NUM_SENSORS = len(ROLES)
+
+COGS = ("engine", "sensors", "telemetry", "xbee_tx", "onewire")
+# The cogs started by the engine, in the order of the mapping.
+STACKS = ("sensors", "telemetry", "xbee_tx", "onewire", "xbee_rx", "buttons")
+TASKS = ("control", "actuators", "convert", "read", "report", "leds",
+         "host", "buttons")
+# Profiler phases and buckets, see src/prof.h.
+PHASES = ("control", "actuators", "convert", "read", "report", "leds",
+          "xbee_send")
+PROF_BUCKETS = 16
+PROF_SHIFT = 11
+
+ACTUATOR_HEATER = 0x01
+ACTUATOR_PUMP = 0x02
+
+ACTIONS = {0: "none", 1: "halted", 2: "heat pump off", 3: "heater off",
+           4: "heater on"}
+HALTS = {0: "", 1: "max heater periods", 2: "bad temperature reading",
+         3: "max air temperature", 4: "stale sensors"}
+
+Frame = collections.namedtuple("Frame", "version type seq payload")
+
+
+def crc16(data, crc=0xFFFF):
+  """CRC-16/CCITT (0x1021), the same as crc16_update() in src/frame.c."""
+  for b in bytearray(data):
+    crc ^= b << 8
+    for _ in range(8):
+      if crc & 0x8000:
+        crc = ((crc << 1) ^ 0x1021) & 0xFFFF
+      else:
+        crc = (crc << 1) & 0xFFFF
+  return crc
+
+
+class FrameDecoder(object):
+  """Incremental frame decoder. Feed it bytes as they come and it yields the
+  frames that passed the CRC check. Anything else is skipped while
+  resynchronizing on the sync marker."""
+
+  def __init__(self):
+    self.buf = bytearray()
+    self.frames = 0
+    self.crc_errors = 0
+    self.skipped = 0
+
+  def feed(self, data):
+    buf = self.buf
+    buf.extend(data)
+    start = 0
+    while True:
+      i = buf.find(SYNC, start)
+      if i < 0:
+        # Keep a trailing first sync byte, it may be the start of a frame.
+        keep = 1 if buf[-1:] == SYNC[:1] else 0
+        self.skipped += len(buf) - start - keep
+        start = len(buf) - keep
+        break
+      self.skipped += i - start
+      start = i
+      if len(buf) - i < HEADER_SIZE:
+        break
+      version, type_, length, seq = struct.unpack_from("<BBBH", buf, i + 2)
+      end = i + HEADER_SIZE + length + CRC_SIZE
+      if len(buf) < end:
+        break
+      crc, = struct.unpack_from("<H", buf, end - CRC_SIZE)
+      if crc16(buf[i + 2:end - CRC_SIZE]) != crc or version != VERSION:
+        self.crc_errors += 1
+        self.skipped += 1
+        start = i + 1
+        continue
+      self.frames += 1
+      yield Frame(version, type_, seq,
+                  bytes(buf[i + HEADER_SIZE:end - CRC_SIZE]))
+      start = end
+    del buf[:start]
+
+
+def decode_status(payload):
+  values = struct.unpack_from("<%dhBBHBBH" % NUM_SENSORS, payload)
+  temps = [None if t == NO_READING else t for t in values[:NUM_SENSORS]]
+  (actuators, action, heater_duty, heater_periods, halt,
+   dropped) = values[NUM_SENSORS:]
+  return {
+    "temp": dict(zip(ROLES, temps)),
+    "heater": bool(actuators & ACTUATOR_HEATER),
+    "pump": bool(actuators & ACTUATOR_PUMP),
+    "action": action,
+    "heater_duty": heater_duty,
+    "heater_periods": heater_periods,
+    "halt": halt,
+    "dropped": dropped,
+  }
+
+
+def decode_boot(payload):
+  num_found, num_sensors = struct.unpack_from("<BB", payload)
+  return {"num_found": num_found, "num_sensors": num_sensors}
+
+
+def decode_idle(payload):
+  record = {}
+  for i, cog in enumerate(COGS):
+    awake, asleep, naps = struct.unpack_from("<IIH", payload, 10 * i)
+    record[cog] = {"awake_us": awake, "asleep_us": asleep, "naps": naps}
+  return record
+
+
+def decode_sched(payload):
+  record = {}
+  for i in range(len(payload) // 6):
+    late_max, overruns = struct.unpack_from("<IH", payload, 6 * i)
+    name = TASKS[i] if i < len(TASKS) else "task%d" % i
+    record[name] = {"late_max_us": late_max, "overruns": overruns}
+  return record
+
+
+def decode_stats(payload):
+  window, = struct.unpack_from("<B", payload)
+  record = {"window": window}
+  for i, role in enumerate(ROLES):
+    mean, min_, max_, stddev, slope, n = struct.unpack_from(
+      "<hhhHhB", payload, 1 + 11 * i)
+    record[role] = None if n == 0 else {
+      "mean": mean, "min": min_, "max": max_, "stddev": stddev,
+      "slope": slope, "n": n}
+  return record
+
+
+def decode_sensor_errors(payload):
+  record = {}
+  for i, role in enumerate(ROLES):
+    errors, failures = struct.unpack_from("<HH", payload, 4 * i)
+    record[role] = {"errors": errors, "failures": failures}
+  return record
+
+
+def decode_buttons(payload):
+  n, dropped = struct.unpack_from("<BH", payload)
+  events = []
+  for i in range(n):
+    button, cnt = struct.unpack_from("<BI", payload, 3 + 5 * i)
+    events.append({"button": button & 0x7F,
+                   "press": bool(button & BUTTON_PRESS), "cnt": cnt})
+  return {"events": events, "dropped": dropped}
+
+
+def decode_memory(payload):
+  n, = struct.unpack_from("<B", payload)
+  record = collections.OrderedDict()
+  for i in range(n):
+    size, used = struct.unpack_from("<HH", payload, 1 + 4 * i)
+    name = STACKS[i] if i < len(STACKS) else "cog%d" % i
+    record[name] = {"size": size, "used": used}
+  return record
+
+
+def decode_profile(payload):
+  n, cycles_per_us = struct.unpack_from("<BB", payload)
+  record = collections.OrderedDict()
+  for i in range(n):
+    values = struct.unpack_from("<I%dH" % PROF_BUCKETS, payload,
+                                2 + (4 + 2 * PROF_BUCKETS) * i)
+    name = PHASES[i] if i < len(PHASES) else "phase%d" % i
+    # Bucket b ends at 2^(PROF_SHIFT + b + 1) cycles.
+    record[name] = {
+      "max_us": values[0] / float(cycles_per_us),
+      "buckets": [((1 << (PROF_SHIFT + b + 1)) / float(cycles_per_us),
+                   count) for b, count in enumerate(values[1:])],
+    }
+  return record
+
+
+def decode_model(payload):
+  flags, samples = struct.unpack_from("<BH", payload)
+  a, b, c, d, e, f = (v / float(MODEL_Q)
+                      for v in struct.unpack_from("<6i", payload, 3))
+  return {"valid": bool(flags & MODEL_VALID), "samples": samples,
+          "soil": {"air": a, "water": b, "bias": c},
+          "water": {"heater": d, "air": e, "soil": f}}
+
+
+def format_tau(k):
+  """Time constant in hours of a coefficient per polling period."""
+  return "%.1fh" % (POLLING_PERIOD / 3600.0 / k) if k > 0 else "--"
+
+
+def format_us(us):
+  return "%.0fus" % us if us < 1000 else "%.1fms" % (us / 1000.0)
+
+
+def read_varint(data, i):
+  value = shift = 0
+  while True:
+    b = data[i]
+    i += 1
+    value |= (b & 0x7F) << shift
+    shift += 7
+    if not b & 0x80:
+      return value, i
+
+
+def read_zigzag(data, i):
+  value, i = read_varint(data, i)
+  return (value >> 1) ^ -(value & 1), i
+
+
+def decode_history_page(page):
+  """Decodes a page of the history log, returns None if it is not valid."""
+  page = bytearray(page)
+  magic, version, crc, seq, boot, time, used = struct.unpack_from(
+    "<BBHIHIB", page)
+  if (magic != HISTORY_MAGIC or version != HISTORY_VERSION or
+      HISTORY_HEADER_SIZE + used > len(page) or
+      crc16(page[4:HISTORY_HEADER_SIZE + used]) != crc):
+    return None
+  records = []
+  duty = 0
+  temps = [0] * NUM_SENSORS
+  i = HISTORY_HEADER_SIZE
+  end = HISTORY_HEADER_SIZE + used
+  while i < end:
+    dt, i = read_varint(page, i)
+    flags = page[i]
+    i += 1
+    delta, i = read_zigzag(page, i)
+    duty += delta
+    for j in range(NUM_SENSORS):
+      delta, i = read_zigzag(page, i)
+      temps[j] += delta
+    time += dt
+    records.append({
+      "time": time,
+      "temp": dict(zip(ROLES, [None if t == NO_READING else t
+                               for t in temps])),
+      "heater": bool(flags & ACTUATOR_HEATER),
+      "pump": bool(flags & ACTUATOR_PUMP),
+      "action": (flags >> 2) & 0x07,
+      "heater_duty": duty,
+      "halt": flags >> 5,
+    })
+  return {"seq": seq, "boot": boot, "records": records}
+
+
+def decode_history(payload):
+  index, flags = struct.unpack_from("<HB", payload)
+  return {"index": index, "last": bool(flags & HISTORY_LAST),
+          "page": decode_history_page(payload[3:])}
+
+
+DECODERS = {STATUS: decode_status, BOOT: decode_boot, IDLE: decode_idle,
+            SCHED: decode_sched, STATS: decode_stats,
+            HISTORY: decode_history, SENSOR_ERRORS: decode_sensor_errors,
+            BUTTONS: decode_buttons, MEMORY: decode_memory,
+            PROFILE: decode_profile, MODEL: decode_model}
+
+
+def decode(frame):
+  """Returns the record of the frame as a dict, or None for unknown types."""
+  decoder = DECODERS.get(frame.type)
+  if decoder is None:
+    return None
+  return decoder(frame.payload)
+
+
+def format_temp(t):
+  return "--" if t is None else "%.2f" % (t / 100.0)
+
+
+def encode_command(type_, seq=0, payload=b""):
+  """Encodes a command frame for the device."""
+  body = struct.pack("<BBBH", VERSION, type_, len(payload), seq) + payload
+  return SYNC + body + struct.pack("<H", crc16(body))
+
+
+def format_frame(frame):
+  record = decode(frame)
+  if frame.type == STATUS:
+    t = record["temp"]
+    line = ("#%-5d A: %s S: %s W: %s heater %s %3.1f%% pump %s periods %d "
+            "%s") % (
+      frame.seq, format_temp(t["air"]),
+      ",".join(format_temp(t[r]) for r in ROLES[1:5]),
+      ",".join(format_temp(t[r]) for r in ROLES[5:7]),
+      "on" if record["heater"] else "off", record["heater_duty"] / 10.0,
+      "on" if record["pump"] else "off",
+      record["heater_periods"], ACTIONS.get(record["action"], "?"))
+    if record["halt"]:
+      line += " HALT %d (%s)" % (record["halt"],
+                                 HALTS.get(record["halt"], "?"))
+    if record["dropped"]:
+      line += " dropped %d" % record["dropped"]
+    return line
+  if frame.type == BOOT:
+    return "#%-5d boot: %d DS18B20 found, %d sensors" % (
+      frame.seq, record["num_found"], record["num_sensors"])
+  if frame.type == IDLE:
+    parts = []
+    for cog in COGS:
+      c = record[cog]
+      total = c["awake_us"] + c["asleep_us"]
+      parts.append("%s %.3f%% (%d naps)" % (
+        cog, 100.0 * c["awake_us"] / total if total else 0.0, c["naps"]))
+    return "#%-5d awake: %s" % (frame.seq, ", ".join(parts))
+  if frame.type == SCHED:
+    names = [t for t in TASKS if t in record] + sorted(
+      t for t in record if t not in TASKS)
+    return "#%-5d late/overruns: %s" % (frame.seq, ", ".join(
+      "%s %.3f ms/%d" % (t, record[t]["late_max_us"] / 1000.0,
+                         record[t]["overruns"]) for t in names))
+  if frame.type == STATS:
+    parts = []
+    for role in ROLES:
+      r = record[role]
+      if r is None:
+        parts.append("%s --" % role)
+        continue
+      parts.append("%s %s [%s..%s] sd %.2f %+.2f/h" % (
+        role, format_temp(r["mean"]), format_temp(r["min"]),
+        format_temp(r["max"]), r["stddev"] / 100.0, r["slope"] / 100.0))
+    return "#%-5d stats over %d samples: %s" % (
+      frame.seq, record["window"], ", ".join(parts))
+  if frame.type == SENSOR_ERRORS:
+    return "#%-5d read errors/lost: %s" % (frame.seq, ", ".join(
+      "%s %d/%d" % (role, record[role]["errors"], record[role]["failures"])
+      for role in ROLES))
+  if frame.type == BUTTONS:
+    line = "#%-5d buttons: %s" % (frame.seq, ", ".join(
+      "%d %s at %d" % (e["button"], "pressed" if e["press"] else "released",
+                       e["cnt"]) for e in record["events"]))
+    if record["dropped"]:
+      line += " dropped %d" % record["dropped"]
+    return line
+  if frame.type == MEMORY:
+    return "#%-5d stack used: %s" % (frame.seq, ", ".join(
+      "%s %d/%d" % (cog, s["used"], s["size"]) for cog, s in record.items()))
+  if frame.type == PROFILE:
+    lines = []
+    for phase, p in record.items():
+      buckets = p["buckets"]
+      line = "#%-5d profile %-9s %5d runs, max %s" % (
+        frame.seq, phase, sum(count for _, count in buckets),
+        format_us(p["max_us"]))
+      for b, (end, count) in enumerate(buckets):
+        if count:
+          line += ", %s%s %d" % ("<" if b < len(buckets) - 1 else ">=",
+                                 format_us(end if b < len(buckets) - 1
+                                           else end / 2), count)
+      lines.append(line)
+    return "\n".join(lines)
+  if frame.type == MODEL:
+    s, w = record["soil"], record["water"]
+    # Full heater in C/h, the bias in C/h per 1 C (MODEL_BIAS).
+    return ("#%-5d model%s over %d samples: soil tau air %s water %s "
+            "bias %+.3fC/h, water heater %.1fC/h tau air %s soil %s") % (
+      frame.seq, "" if record["valid"] else " (not used)",
+      record["samples"], format_tau(s["air"]), format_tau(s["water"]),
+      s["bias"] * 3600.0 / POLLING_PERIOD,
+      w["heater"] * 1000 / 100.0 * 3600.0 / POLLING_PERIOD,
+      format_tau(w["air"]), format_tau(w["soil"]))
+  if frame.type == HISTORY:
+    page = record["page"]
+    head = "#%-5d history %d%s:" % (frame.seq, record["index"],
+                                    " (last)" if record["last"] else "")
+    if page is None:
+      return head + " bad page"
+    lines = ["%s page %d of boot %d, %d records" % (
+      head, page["seq"], page["boot"], len(page["records"]))]
+    for r in page["records"]:
+      t = r["temp"]
+      line = ("       boot %d %02d:%02d:%02d A: %s S: %s W: %s heater %s "
+              "%3.1f%% pump %s %s") % (
+        page["boot"], r["time"] // 3600, r["time"] // 60 % 60,
+        r["time"] % 60, format_temp(t["air"]),
+        ",".join(format_temp(t[x]) for x in ROLES[1:5]),
+        ",".join(format_temp(t[x]) for x in ROLES[5:7]),
+        "on" if r["heater"] else "off", r["heater_duty"] / 10.0,
+        "on" if r["pump"] else "off", ACTIONS.get(r["action"], "?"))
+      if r["halt"]:
+        line += " HALT %d (%s)" % (r["halt"], HALTS.get(r["halt"], "?"))
+      lines.append(line)
+    return "\n".join(lines)
+  return "#%-5d type %d: %d bytes" % (frame.seq, frame.type,
+                                      len(frame.payload))
+
+
+def open_stream(path, mode=os.O_RDONLY):
+  if path == "-":
+    return getattr(sys.stdin, "buffer", sys.stdin).fileno()
+  fd = os.open(path, mode | os.O_NOCTTY)
+  if os.isatty(fd):
+    import termios
+    import tty
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    attrs[4] = attrs[5] = termios.B9600
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+  return fd
+
+
+def read_packets(fd):
+  """The transmit requests and the received packets of the stream."""
+  decoder = xbee_api.Decoder()
+  while True:
+    try:
+      data = os.read(fd, 4096)
+    except OSError:
+      # The other end of a PTY went away.
+      return
+    if not data:
+      return
+    for frame in decoder.feed(data):
+      packet = xbee_api.decode_packet(frame)
+      if packet is not None:
+        yield packet
+
+
+def main(argv):
+  args = argv[1:]
+  commands = []
+  if "--cold-start" in args:
+    args.remove("--cold-start")
+    commands.append(("cold start", CMD_COLD_START))
+  if "--dump" in args:
+    args.remove("--dump")
+    commands.append(("history dump", CMD_HISTORY_DUMP))
+  dest = xbee_api.BROADCAST16
+  if "--to" in args:
+    i = args.index("--to")
+    dest = xbee_api.parse_addr(args[i + 1])
+    del args[i:i + 2]
+  path = args[0] if args else "-"
+  if commands and path == "-":
+    print("--dump and --cold-start need the serial port", file=sys.stderr)
+    return 2
+  fd = open_stream(path, os.O_RDWR if commands else os.O_RDONLY)
+  if commands:
+    coordinator = xbee_api.Coordinator(fd)
+    for name, cmd in commands:
+      ids = coordinator.send(dest, encode_command(cmd))
+      status = coordinator.wait_status(ids)[0]
+      print("%s to %s: %s" % (
+        name, xbee_api.format_addr(dest),
+        xbee_api.STATUSES.get(status, "no TX status")), file=sys.stderr)
+    packets = coordinator.packets()
+  else:
+    packets = read_packets(fd)
+  decoders = collections.OrderedDict()
+  for packet in packets:
+    unit = None
+    if packet.api_id in (xbee_api.RX64, xbee_api.RX16):
+      unit = xbee_api.format_addr(packet.addr)
+    decoder = decoders.setdefault(unit, FrameDecoder())
+    for frame in decoder.feed(packet.data):
+      text = format_frame(frame)
+      if unit is not None:
+        text = "\n".join("%s %s" % (unit, line)
+                         for line in text.split("\n"))
+      print(text)
+      sys.stdout.flush()
+  for unit, decoder in decoders.items():
+    print("%s%d frames, %d CRC errors, %d bytes skipped" % (
+      unit + ": " if unit else "", decoder.frames, decoder.crc_errors,
+      decoder.skipped), file=sys.stderr)
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main(sys.argv))
@@ -0,0 +1,309 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2013 Sladeware LLC.
+#
+# Hub RAM budget of a Vegimeter 2 build.
+#
+# Usage: vegimeter_mem.py [--hub BYTES] [--exclude UNIT,...] [--advisory]
+#                         vegimeter2.map DUMPDIR...
+#
+# --hub 0 leaves out the budget, for the host build of sim/.
+# --exclude leaves the functions of the named source files out of the call
+# graph, for the simulator of sim/ that stands in for the hardware.
+# --advisory still reports the stack overflows but exits with 0, for frame
+# sizes that are not those of propgcc.
+#
+# The sizes of the code, data and BSS come from the linker map, by section
+# and by object file. The stack depth of every cog comes from a static call
+# graph: the frame size of each function from the .su files of
+# -fstack-usage and its calls from the RTL dumps of -fdump-rtl-expand, both
+# looked for in the DUMPDIRs. The worst path from the runner of a cog is
+# compared with the stack it gets in src/vegimeter2_tables.h.
+#
+# Calls through a pointer, the scheduler tasks, are taken to be calls to any
+# function whose address is taken in the source file of the cog's runner.
+# Recursion and frames of unbounded size are reported, not followed.
+#
+# The runtime high-water marks are in the FRAME_MEMORY telemetry frame, see
+# src/stack.h.
+
+from __future__ import print_function
+
+import collections
+import os
+import re
+import sys
+
+HUB_BYTES = 32768
+
+TABLES_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                           os.pardir, "src", "vegimeter2_tables.h")
+
+# The mapping thread runs on the stack that is left at the top of hub RAM.
+ENGINE_RUNNER = "engine_runner"
+
+Function = collections.namedtuple("Function", "name unit source frame kind")
+
+SECTION = re.compile(r"^(\.[\w.$-]+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)")
+SECTION_NAME = re.compile(r"^(\.[\w.$-]+)$")
+SECTION_SIZE = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)")
+INPUT = re.compile(r"^ (\.[\w.$-]+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)"
+                   r"\s+(\S+)$")
+STACK_SIZE = re.compile(r"#define (\w+)_STACK_SIZE \(\(EXTRA_STACK_BYTES"
+                        r" \+ (\d+)\) / 4\)")
+COG_ROW = re.compile(r"\{ (\w+), (\w+)_stack, sizeof")
+FUNCTION = re.compile(r"^;; Function (\S+)")
+CALL = re.compile(r"\(call \(mem:\w+ \((symbol_ref|reg)[^ ]* "
+                  r"(?:\(\"([^\"]+)\")?")
+
+
+def section_class(name):
+  """code, data, bss or None for what is not loaded in hub RAM."""
+  if name.startswith((".debug", ".comment", ".stab", ".note", ".gnu")):
+    return None
+  if "bss" in name or name in (".heap", ".stack"):
+    return "bss"
+  if name.startswith((".data", ".hub", ".rodata", ".ctors", ".dtors")):
+    return "data"
+  return "code"
+
+
+def read_map(path):
+  """Returns ({section: size}, {(class, object): size}) of the loaded
+  sections of a GNU ld map."""
+  sections = collections.OrderedDict()
+  objects = collections.Counter()
+  with open(path) as f:
+    lines = f.read().split("\n")
+  try:
+    start = lines.index("Linker script and memory map")
+  except ValueError:
+    start = 0
+  current = None
+  pending = None
+  for line in lines[start:]:
+    m = SECTION.match(line)
+    if m is None and pending is not None:
+      # A long section name, its address and size are on the next line.
+      m = SECTION_SIZE.match(line)
+      if m is not None:
+        m = (pending, m.group(1), m.group(2))
+    elif m is not None:
+      m = m.groups()
+    pending = None
+    if m is not None:
+      name, size = m[0], int(m[2], 16)
+      current = section_class(name)
+      if current is not None and size:
+        sections[name] = size
+      continue
+    m = SECTION_NAME.match(line)
+    if m is not None:
+      pending = m.group(1)
+      current = None
+      continue
+    m = INPUT.match(line)
+    if m is not None and current is not None:
+      size = int(m.group(3), 16)
+      if size:
+        objects[(current, os.path.basename(m.group(4)))] += size
+  return sections, objects
+
+
+def read_cogs(path=TABLES_PATH):
+  """Returns [(cog, runner, stack bytes)] in start order, with the mapping
+  thread first."""
+  with open(path) as f:
+    text = f.read()
+  sizes = dict((name.lower(), int(size))
+               for name, size in STACK_SIZE.findall(text))
+  cogs = [("engine", ENGINE_RUNNER, None)]
+  for runner, cog in COG_ROW.findall(text):
+    cogs.append((cog, runner, sizes.get(cog)))
+  return cogs
+
+
+def unit_of(path):
+  """engine.su, engine.c.150r.expand and ../src/engine.c are all engine."""
+  return os.path.basename(path).split(".")[0]
+
+
+def read_dumps(dirs):
+  """Returns ({unit: {name: Function}}, {(unit, name): [callee or None]}).
+  None is a call through a pointer."""
+  functions = collections.defaultdict(dict)
+  calls = {}
+  for d in dirs:
+    for name in sorted(os.listdir(d)):
+      path = os.path.join(d, name)
+      if name.endswith(".su"):
+        with open(path) as f:
+          for line in f:
+            where, frame, kind = line.rstrip("\n").split("\t")
+            parts = where.split(":")
+            source, func = parts[0], parts[-1]
+            functions[unit_of(name)][func] = Function(
+              func, unit_of(name), source, int(frame), kind)
+      elif name.endswith(".expand"):
+        unit, func = unit_of(name), None
+        with open(path) as f:
+          for line in f:
+            m = FUNCTION.match(line)
+            if m is not None:
+              func = m.group(1)
+              calls[(unit, func)] = []
+              continue
+            m = CALL.search(line)
+            if m is not None and func is not None:
+              callee = m.group(2) if m.group(1) == "symbol_ref" else None
+              calls[(unit, func)].append(callee)
+  return functions, calls
+
+
+class CallGraph(object):
+  def __init__(self, functions, calls, exclude=()):
+    self.functions = functions
+    self.calls = calls
+    self.exclude = set(exclude)
+    self.globals = {}
+    for unit, funcs in functions.items():
+      for f in funcs.values():
+        self.globals.setdefault(f.name, f)
+
+  def find(self, name, unit=None):
+    """The function called name, the static one of unit first."""
+    if unit is not None and name in self.functions.get(unit, {}):
+      return self.functions[unit][name]
+    return self.globals.get(name)
+
+  def address_taken(self, unit):
+    """Functions of unit named in its source other than in a call."""
+    funcs = self.functions.get(unit, {})
+    sources = set(f.source for f in funcs.values())
+    text = ""
+    for source in sources:
+      if os.path.exists(source):
+        with open(source) as f:
+          text += f.read()
+    taken = []
+    for name in sorted(funcs):
+      if re.search(r"\b%s\b(?!\s*\()" % re.escape(name), text):
+        taken.append(funcs[name])
+    return taken
+
+  def depth(self, runner):
+    """Returns (bytes, path, notes) of the deepest call chain from the
+    runner."""
+    root = self.find(runner)
+    if root is None:
+      return None, [], ["%s: no stack usage" % runner]
+    targets = self.address_taken(root.unit)
+    notes = set()
+    memo = {}
+
+    def visit(f, stack):
+      key = (f.unit, f.name)
+      if key in memo:
+        return memo[key]
+      if key in stack:
+        notes.add("recursion in %s" % f.name)
+        return 0, []
+      if not f.kind.startswith("static") and "bounded" not in f.kind:
+        notes.add("%s: frame of unbounded size" % f.name)
+      best, best_path = 0, []
+      for callee in self.calls.get(key, []):
+        if callee is None:
+          candidates = [t for t in targets if (t.unit, t.name) != key]
+        else:
+          c = self.find(callee, f.unit)
+          if c is None:
+            notes.add("%s: no stack usage" % callee)
+            continue
+          candidates = [c]
+        candidates = [c for c in candidates if c.unit not in self.exclude]
+        for c in candidates:
+          d, path = visit(c, stack | set([key]))
+          if d > best:
+            best, best_path = d, path
+      memo[key] = (f.frame + best, [f.name] + best_path)
+      return memo[key]
+
+    depth, path = visit(root, frozenset())
+    return depth, path, sorted(notes)
+
+
+def main(argv):
+  args = argv[1:]
+  hub = HUB_BYTES
+  exclude = []
+  advisory = "--advisory" in args
+  if advisory:
+    args.remove("--advisory")
+  if "--hub" in args:
+    i = args.index("--hub")
+    hub = int(args[i + 1], 0)
+    del args[i:i + 2]
+  if "--exclude" in args:
+    i = args.index("--exclude")
+    exclude = args[i + 1].split(",")
+    del args[i:i + 2]
+  if len(args) < 2:
+    print("usage: vegimeter_mem.py [--hub BYTES] [--exclude UNIT,...] "
+          "[--advisory] MAP DUMPDIR...", file=sys.stderr)
+    return 2
+  sections, objects = read_map(args[0])
+
+  totals = collections.Counter()
+  for name, size in sections.items():
+    totals[section_class(name)] += size
+  used = sum(totals.values())
+  if hub:
+    print("hub RAM: %d of %d bytes, %d free" % (used, hub, hub - used))
+  else:
+    print("loaded: %d bytes" % used)
+  for cls in ("code", "data", "bss"):
+    print("  %-5s %6d" % (cls, totals[cls]))
+  print()
+  print("sections:")
+  for name, size in sections.items():
+    print("  %-16s %-5s %6d" % (name, section_class(name), size))
+  print()
+  print("objects:")
+  names = sorted(set(o for _, o in objects),
+                 key=lambda o: -sum(objects[(c, o)]
+                                    for c in ("code", "data", "bss")))
+  print("  %-24s %6s %6s %6s" % ("", "code", "data", "bss"))
+  for o in names:
+    print("  %-24s %6d %6d %6d" % (o, objects[("code", o)],
+                                   objects[("data", o)], objects[("bss", o)]))
+  print()
+
+  functions, calls = read_dumps(args[1:])
+  graph = CallGraph(functions, calls, exclude)
+  status = 0
+  if advisory:
+    print("stacks (advisory, not the frame sizes of the Propeller):")
+  else:
+    print("stacks:")
+  for cog, runner, size in read_cogs():
+    depth, path, notes = graph.depth(runner)
+    if depth is None:
+      line = "  %-10s %-16s unknown" % (cog, runner)
+    elif size is None:
+      line = "  %-10s %-16s %5d bytes" % (cog, runner, depth)
+    else:
+      line = "  %-10s %-16s %5d of %5d bytes, %d free" % (
+        cog, runner, depth, size, size - depth)
+      if depth > size:
+        line += " OVERFLOW"
+        status = 0 if advisory else 1
+    print(line)
+    if path:
+      print("    %s" % " > ".join(path))
+    for note in notes:
+      print("    %s" % note)
+  return status
+
+
+if __name__ == "__main__":
+  sys.exit(main(sys.argv))
@@ -0,0 +1,245 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2013 Sladeware LLC.
+#
+# XBee API frames, escaped (AP=2), for the 802.15.4 (Series 1) modules, and
+# the host end of the network: a coordinator on a serial port. The same
+# frames as src/xbee_api.h.
+
+from __future__ import print_function
+
+import collections
+import os
+import select
+import struct
+import time
+
+START = 0x7E
+ESCAPE = 0x7D
+XON = 0x11
+XOFF = 0x13
+ESCAPED = (START, ESCAPE, XON, XOFF)
+
+TX64 = 0x00
+TX16 = 0x01
+RX64 = 0x80
+RX16 = 0x81
+TX_STATUS = 0x89
+
+SUCCESS = 0
+NO_ACK = 1
+CCA_FAILURE = 2
+PURGED = 3
+STATUSES = {SUCCESS: "success", NO_ACK: "no ack", CCA_FAILURE: "CCA failure",
+            PURGED: "purged"}
+
+DISABLE_ACK = 0x01
+
+BROADCAST16 = b"\xff\xff"
+COORDINATOR16 = b"\x00\x00"
+
+MAX_PAYLOAD = 100
+MAX_FRAME = 11 + MAX_PAYLOAD
+
+# api_id, frame_id (transmit requests), addr (destination or source, 2 or 8
+# bytes), rssi (received packets, -dBm), options, data.
+Packet = collections.namedtuple("Packet",
+                                "api_id frame_id addr rssi options data")
+
+
+def escape(data):
+  out = bytearray()
+  for b in bytearray(data):
+    if b in ESCAPED:
+      out.append(ESCAPE)
+      b ^= 0x20
+    out.append(b)
+  return bytes(out)
+
+
+def encode(frame):
+  """Encodes the frame data of an API frame, with its length and checksum."""
+  frame = bytearray(frame)
+  checksum = 0xFF - (sum(frame) & 0xFF)
+  return (bytes(bytearray([START])) +
+          escape(struct.pack(">H", len(frame)) + bytes(frame) +
+                 bytes(bytearray([checksum]))))
+
+
+def encode_tx(frame_id, dest, data, options=0):
+  """A transmit request to dest, a 16-bit or a 64-bit address as bytes."""
+  api_id = TX16 if len(dest) == 2 else TX64
+  return encode(bytearray([api_id, frame_id]) + bytearray(dest) +
+                bytearray([options]) + bytearray(data))
+
+
+def encode_rx(src, data, rssi=40, options=0):
+  """A packet received from src, as the XBee hands it over."""
+  api_id = RX16 if len(src) == 2 else RX64
+  return encode(bytearray([api_id]) + bytearray(src) +
+                bytearray([rssi, options]) + bytearray(data))
+
+
+def encode_tx_status(frame_id, status):
+  return encode(bytearray([TX_STATUS, frame_id, status]))
+
+
+def decode_packet(frame):
+  """Decodes the frame data of a transmit request or a received packet,
+  None for other frames."""
+  frame = bytearray(frame)
+  if not frame:
+    return None
+  api_id = frame[0]
+  if api_id not in (TX64, TX16, RX64, RX16):
+    return None
+  i = 1
+  frame_id = 0
+  if api_id in (TX64, TX16):
+    frame_id = frame[i]
+    i += 1
+  size = 2 if api_id & 0x01 else 8
+  received = bool(api_id & 0x80)
+  if len(frame) < i + size + 1 + received:
+    return None
+  addr = bytes(frame[i:i + size])
+  i += size
+  rssi = 0
+  if received:
+    rssi = frame[i]
+    i += 1
+  options = frame[i]
+  return Packet(api_id, frame_id, addr, rssi, options, bytes(frame[i + 1:]))
+
+
+def format_addr(addr):
+  return "".join("%02X" % b for b in bytearray(addr))
+
+
+def parse_addr(text):
+  """"0001" is a 16-bit address, 16 hex digits a 64-bit one."""
+  if len(text) not in (4, 16):
+    raise ValueError("an address is 4 or 16 hex digits: %r" % text)
+  return bytes(bytearray(int(text[i:i + 2], 16)
+                         for i in range(0, len(text), 2)))
+
+
+class Decoder(object):
+  """Incremental API frame decoder. Feed it bytes as they come and it
+  yields the frame data of the frames with a good checksum."""
+
+  def __init__(self):
+    self.frame = None
+    self.escaped = False
+    self.length = None
+    self.frames = 0
+    self.errors = 0
+
+  def feed(self, data):
+    for b in bytearray(data):
+      if b == START:
+        # Never escaped, a new frame even in the middle of another one.
+        if self.frame is not None:
+          self.errors += 1
+        self.frame = bytearray()
+        self.length = None
+        self.escaped = False
+        continue
+      if self.frame is None:
+        continue
+      if b == ESCAPE:
+        self.escaped = True
+        continue
+      if self.escaped:
+        b ^= 0x20
+        self.escaped = False
+      self.frame.append(b)
+      if self.length is None:
+        if len(self.frame) == 2:
+          self.length = struct.unpack(">H", bytes(self.frame))[0]
+          self.frame = bytearray()
+          if not 0 < self.length <= MAX_FRAME:
+            self.errors += 1
+            self.frame = None
+        continue
+      if len(self.frame) < self.length + 1:
+        continue
+      frame, self.frame = self.frame, None
+      if sum(frame) & 0xFF != 0xFF:
+        self.errors += 1
+        continue
+      self.frames += 1
+      yield bytes(frame[:-1])
+
+
+class Coordinator(object):
+  """The host end of the network, on the serial port of the coordinator.
+
+  send() splits the data into packets and returns their frame ids, the TX
+  status of each one lands in status as it comes. packets() yields the
+  packets received from the units, with their source address."""
+
+  def __init__(self, fd):
+    self.fd = fd
+    self.decoder = Decoder()
+    self.next_id = 1
+    self.status = {}
+    self.pending = set()
+    self.received = collections.deque()
+
+  def send(self, dest, data, options=0):
+    ids = []
+    data = bytes(data)
+    for i in range(0, max(len(data), 1), MAX_PAYLOAD):
+      frame_id = self.next_id
+      # 0 would ask for no TX status.
+      self.next_id = self.next_id % 255 + 1
+      self.status.pop(frame_id, None)
+      self.pending.add(frame_id)
+      os.write(self.fd, encode_tx(frame_id, dest, data[i:i + MAX_PAYLOAD],
+                                  options))
+      ids.append(frame_id)
+    return ids
+
+  def poll(self, timeout=None):
+    """Reads what came, waiting up to timeout seconds for it. Returns False
+    at the end of the stream."""
+    if timeout is not None:
+      ready, _, _ = select.select([self.fd], [], [], timeout)
+      if not ready:
+        return True
+    try:
+      data = os.read(self.fd, 4096)
+    except OSError:
+      # The other end of a PTY went away.
+      return False
+    if not data:
+      return False
+    for frame in self.decoder.feed(data):
+      frame = bytearray(frame)
+      if frame[0] == TX_STATUS and len(frame) >= 3:
+        self.pending.discard(frame[1])
+        self.status[frame[1]] = frame[2]
+        continue
+      packet = decode_packet(frame)
+      if packet is not None and packet.api_id in (RX64, RX16):
+        self.received.append(packet)
+    return True
+
+  def wait_status(self, ids, timeout=2.0):
+    """Waits for the TX status of the packets. Returns them in order, None
+    for the ones that did not come. Packets received meanwhile are kept for
+    packets()."""
+    deadline = time.time() + timeout
+    while any(i in self.pending for i in ids):
+      left = deadline - time.time()
+      if left <= 0 or not self.poll(left):
+        break
+    return [self.status.get(i) for i in ids]
+
+  def packets(self):
+    while True:
+      while self.received:
+        yield self.received.popleft()
+      if not self.poll():
+        return
@@ -0,0 +1,141 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2013 Sladeware LLC.
+#
+# Simulated coordinator XBee on a PTY pair, to run the host tools against a
+# network without the radios. It plays the packets of a capture of the
+# simulator (sim/vegimeter_bench -o) as if that many units had sent them,
+# each one from its own address, and answers the transmit requests of the
+# host with a TX status, as the coordinator does in API mode (AP=2).
+#
+# Usage: xbee_radio.py [-n units] [-r packets/s] [--loss p] capture.bin
+#
+# It prints the PTY to open, for instance
+#
+#   vegimeter_ingest -c /dev/pts/5
+#   vegimeter_frame.py --dump --to 0003 /dev/pts/5
+#
+# Odd units are heard by their 16-bit address (0001, 0003...), even ones
+# have none (MY=0xFFFE) and are heard by a 64-bit one (0013A20000000002...).
+# --loss is the odds that a transmit request to a unit gets no ACK.
+
+from __future__ import print_function
+
+import os
+import random
+import select
+import struct
+import sys
+import time
+import tty
+
+import xbee_api
+
+START_DELAY = 1.0 # Seconds for the host to open the PTY
+LINGER = 2.0 # Seconds to wait for commands after the last packet
+
+
+def unit_addr(i):
+  if i % 2:
+    return struct.pack(">H", i)
+  return b"\x00\x13\xa2\x00" + struct.pack(">I", i)
+
+
+def capture_packets(path):
+  """The data of the transmit requests of a capture."""
+  decoder = xbee_api.Decoder()
+  with open(path, "rb") as f:
+    data = f.read()
+  for frame in decoder.feed(data):
+    packet = xbee_api.decode_packet(frame)
+    if packet is not None and packet.api_id in (xbee_api.TX16,
+                                                xbee_api.TX64):
+      yield packet.data
+
+
+class Radio(object):
+
+  def __init__(self, fd, units, loss):
+    self.fd = fd
+    self.units = dict((unit_addr(i), i) for i in range(1, units + 1))
+    self.loss = loss
+    self.decoder = xbee_api.Decoder()
+    self.commands = {}
+    self.no_acks = 0
+
+  def serve(self, timeout=0):
+    """Answers the transmit requests that came in."""
+    while select.select([self.fd], [], [], timeout)[0]:
+      timeout = 0
+      try:
+        data = os.read(self.fd, 4096)
+      except OSError:
+        return
+      for frame in self.decoder.feed(data):
+        packet = xbee_api.decode_packet(frame)
+        if packet is None or packet.api_id not in (xbee_api.TX16,
+                                                   xbee_api.TX64):
+          continue
+        if packet.addr == xbee_api.BROADCAST16:
+          # Broadcasts are not acknowledged.
+          status = xbee_api.SUCCESS
+          for addr in self.units:
+            self.commands[addr] = self.commands.get(addr, 0) + 1
+        elif packet.addr in self.units and random.random() >= self.loss:
+          status = xbee_api.SUCCESS
+          self.commands[packet.addr] = self.commands.get(packet.addr, 0) + 1
+        else:
+          status = xbee_api.NO_ACK
+          self.no_acks += 1
+        if packet.frame_id:
+          os.write(self.fd, xbee_api.encode_tx_status(packet.frame_id,
+                                                      status))
+
+
+def main(argv):
+  args = argv[1:]
+  units, rate, loss = 10, 0.0, 0.0
+  while len(args) > 1 and args[0].startswith("-"):
+    option, value = args[:2]
+    del args[:2]
+    if option == "-n":
+      units = int(value)
+    elif option == "-r":
+      rate = float(value)
+    elif option == "--loss":
+      loss = float(value)
+    else:
+      args = []
+  if len(args) != 1:
+    print("usage: xbee_radio.py [-n units] [-r packets/s] [--loss p] "
+          "capture.bin", file=sys.stderr)
+    return 2
+
+  master, slave = os.openpty()
+  # Raw both ways, the host must not get its own bytes back.
+  tty.setraw(slave)
+  print(os.ttyname(slave))
+  sys.stdout.flush()
+  radio = Radio(master, units, loss)
+  time.sleep(START_DELAY)
+  packets = 0
+  start = time.time()
+  for data in capture_packets(args[0]):
+    for addr in sorted(radio.units, key=radio.units.get):
+      os.write(master, xbee_api.encode_rx(addr, data))
+      packets += 1
+      if rate:
+        radio.serve(max(0.0, start + packets / rate - time.time()))
+      else:
+        radio.serve()
+  radio.serve(LINGER)
+  print("%d packets from %d units, %d commands delivered, %d not "
+        "acknowledged" % (packets, units, sum(radio.commands.values()),
+                          radio.no_acks), file=sys.stderr)
+  os.close(slave)
+  os.close(master)
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main(sys.argv))
@@ -1,17 +1,198 @@
 #!/usr/bin/env python
 #
 # Copyright (c) 2013 Sladeware LLC.
+#
+# The vegimeter2 mapping. It is also the one place where the sensors and the
+# cogs are declared: write_tables() turns the tables below into
+# src/vegimeter2_tables.h, which the firmware and the simulator build on.
+# Adding a probe is a new row in SENSORS.
+#
+#   python vegimeter2.py    regenerate src/vegimeter2_tables.h
+
+import os
 
 import bb.app
 from bb.app.hardware.devices.boards import P8X32A_QuickStartBoard
 
+# Sensor kinds, as in src/sensors.h. The kind tells the control loop what a
+# probe measures and the sensing cog which threshold it is compared with.
+AIR = "SENSOR_KIND_AIR"
+SOIL = "SENSOR_KIND_SOIL"
+WATER = "SENSOR_KIND_WATER"
+
+class Sensor(object):
+  """A DS18B20 probe. The role names it in the firmware (SENSOR_<ROLE>) and
+  is its index in the sensor table, in the order of SENSORS. rom is the ROM
+  ID, from the family code to the CRC, when the probe shares its pin with
+  other slaves; without it the probe is bound to the only slave found on
+  the pin. offset is a calibration in centi-Celsius added to its readings.
+  every is how many sensing periods there are between two samples."""
+
+  def __init__(self, role, kind, pin, rom=None, offset=0, every=1):
+    self.role = role
+    self.kind = kind
+    self.pin = pin
+    self.rom = rom
+    self.offset = offset
+    self.every = every
+
+class Cog(object):
+  """A cog. The one without a stack is the ENGINE thread of the mapping,
+  the others are started by the engine in the order of COGS with stack
+  bytes of stack (plus EXTRA_STACK_BYTES) and <name>_runner() as entry
+  point. Cogs with idle set get an idle account, IDLE_<NAME>, in the same
+  order."""
+
+  def __init__(self, name, runner, stack=None, idle=True):
+    self.name = name
+    self.runner = runner
+    self.stack = stack
+    self.idle = idle
+
+SENSORS = [
+  Sensor("AIR", AIR, pin=8),
+  Sensor("SOIL_A", SOIL, pin=10),
+  Sensor("SOIL_B", SOIL, pin=13),
+  Sensor("SOIL_C", SOIL, pin=14),
+  Sensor("SOIL_D", SOIL, pin=12),
+  Sensor("WATER_A", WATER, pin=11),
+  Sensor("WATER_B", WATER, pin=9),
+]
+
+COGS = [
+  Cog("ENGINE", "engine_runner"),
+  Cog("SENSORS", "sensors_runner", stack=384),
+  Cog("TELEMETRY", "telemetry_runner", stack=640),
+  Cog("XBEE_TX", "xbee_tx_runner", stack=768),
+  Cog("ONEWIRE", "ow_cog_runner", stack=256),
+  # Busy in waitpeq on the RX pin, nothing to account.
+  Cog("XBEE_RX", "xbee_rx_runner", stack=128, idle=False),
+  # Asleep in waitpne until a pad is touched.
+  Cog("BUTTONS", "buttons_runner", stack=128, idle=False),
+]
+
+TABLES_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                           "src", "vegimeter2_tables.h")
+
+def check_tables():
+  roles = [s.role for s in SENSORS]
+  if len(set(roles)) != len(roles):
+    raise ValueError("duplicate sensor role")
+  for s in SENSORS:
+    if not 0 <= s.pin < 32:
+      raise ValueError("%s: no such pin %d" % (s.role, s.pin))
+    if s.rom is not None and len(s.rom) != 8:
+      raise ValueError("%s: a ROM ID is 8 bytes" % s.role)
+    if not 1 <= s.every <= 255:
+      raise ValueError("%s: every must be 1 to 255" % s.role)
+    if s.rom is None and len([t for t in SENSORS if t.pin == s.pin]) > 1:
+      raise ValueError("%s: pin %d is shared, a ROM ID is needed"
+                       % (s.role, s.pin))
+  for kind in (AIR, SOIL, WATER):
+    if not [s for s in SENSORS if s.kind == kind]:
+      raise ValueError("the control loop needs a %s probe" % kind)
+  if len([c for c in COGS if c.stack is None]) != 1:
+    raise ValueError("exactly one cog runs the mapping thread")
+  if len(COGS) > 8:
+    raise ValueError("the P8X32A has 8 cogs")
+
+def render_tables():
+  check_tables()
+  lines = [
+    "/*",
+    " * Copyright (c) 2013 Sladeware LLC",
+    " *",
+    " * Generated by vegimeter2.py from the mapping, do not edit.",
+    " */",
+    "#ifndef __VEGIMETER2_TABLES_H",
+    "#define __VEGIMETER2_TABLES_H",
+    "",
+    "/* Sensor roles. Also used as indices into the sensor table. */",
+  ]
+  for i, s in enumerate(SENSORS):
+    lines.append("#define SENSOR_%s %d" % (s.role, i))
+  lines += [
+    "#define NUM_SENSORS %d" % len(SENSORS),
+    "/* Role names for the host tools. */",
+    "#define SENSOR_NAMES { \\",
+  ]
+  for s in SENSORS:
+    lines.append("  \"%s\", \\" % s.role.lower())
+  lines += [
+    "}",
+    "",
+    "/* struct sensor_config rows, in role order. */",
+    "#define SENSOR_CONFIG { \\",
+  ]
+  for s in SENSORS:
+    rom = ", ".join("0x%02X" % b for b in s.rom or [0])
+    lines.append("  { %d, %s, %d, %d, { %s } }, /* SENSOR_%s */ \\"
+                 % (s.pin, s.kind, s.offset, s.every, rom, s.role))
+  lines += [
+    "}",
+    "",
+    "/* Cogs with an idle account. */",
+  ]
+  idle = [c for c in COGS if c.idle]
+  for i, c in enumerate(idle):
+    lines.append("#define IDLE_%s %d" % (c.name, i))
+  lines += [
+    "#define IDLE_NUM_COGS %d" % len(idle),
+    "",
+    "/* Cog stack sizes in ints. */",
+  ]
+  started = [c for c in COGS if c.stack is not None]
+  for c in started:
+    lines.append("#define %s_STACK_SIZE ((EXTRA_STACK_BYTES + %d) / 4)"
+                 % (c.name, c.stack))
+  lines += [
+    "",
+    "/* The stacks, named after the cogs, defined once by the engine. */",
+    "#define COG_STACKS \\",
+  ]
+  for c in started:
+    end = "" if c is started[-1] else "; \\"
+    lines.append("  HUBDATA static int %s_stack[%s_STACK_SIZE]%s"
+                 % (c.name.lower(), c.name, end))
+  lines += [
+    "",
+    "/* struct cog_config rows, in start order. */",
+    "#define NUM_STARTED_COGS %d" % len(started),
+    "#define COG_CONFIG { \\",
+  ]
+  for c in started:
+    stack = "%s_stack" % c.name.lower()
+    lines.append("  { %s, %s, sizeof(%s) }, \\" % (c.runner, stack, stack))
+  lines += [
+    "}",
+    "",
+    "#endif /* __VEGIMETER2_TABLES_H */",
+    "",
+  ]
+  return "\n".join(lines)
+
+def write_tables(path=TABLES_PATH):
+  """Writes the header, only when it changed so that nothing rebuilds for
+  nothing."""
+  text = render_tables()
+  if os.path.exists(path):
+    with open(path) as f:
+      if f.read() == text:
+        return
+  with open(path, "w") as f:
+    f.write(text)
+
 board = P8X32A_QuickStartBoard()
 vegimeter2 = bb.app.Mapping(
   name='vegimeter2',
   #thread_distributor=bb.app.DummyThreadDistributor(),
   processor=board.get_processor(),
   threads=[
-    # Add user interface thread
-    bb.app.Thread('ENGINE', 'engine_runner', port=bb.app.os.Port(10)),
+    # The control loop, it starts the other cogs.
+    bb.app.Thread(c.name, c.runner, port=bb.app.os.Port(10))
+    for c in COGS if c.stack is None
   ]
 )
+
+if __name__ == '__main__':
+  write_tables()